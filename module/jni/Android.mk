@@ -11,13 +11,27 @@ LOCAL_SRC_FILES := \
     zygisk_main.cpp \
     camera_hook.cpp \
     frame_utils.cpp \
-    media_reader.cpp
+    frame_buffer.cpp \
+    frame_cache.cpp \
+    frame_pool.cpp \
+    frame_ring.cpp \
+    frame_scaler.cpp \
+    frame_simd.cpp \
+    frame_transform.cpp \
+    hardware_buffer.cpp \
+    image_frame_map.cpp \
+    media_reader.cpp \
+    media_watcher.cpp \
+    nal_parser.cpp \
+    output_plan.cpp \
+    pipeline_stats.cpp
 
 LOCAL_C_INCLUDES := $(LOCAL_PATH)
 
 LOCAL_LDLIBS := \
     -llog \
     -landroid \
+    -lnativewindow \
     -lmediandk \
     -ldl
 
@@ -0,0 +1,58 @@
+/*
+ * DroidFakeCam - Benchmark Helpers
+ *
+ * Timing and test-pattern helpers shared by the host benchmarks.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_utils.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace Bench {
+
+// Milliseconds per call of `fn`, after one warm-up call (caches, frame
+// pool, scaler tables), repeating for at least `minMs`
+template <typename Fn>
+double timeMs(Fn fn, double minMs = 250.0, int* iterationsOut = nullptr) {
+    using Clock = std::chrono::steady_clock;
+    fn();
+
+    int iterations = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    do {
+        fn();
+        iterations++;
+        elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    } while (elapsed < minMs);
+
+    if (iterationsOut) {
+        *iterationsOut = iterations;
+    }
+    return elapsed / iterations;
+}
+
+// Deterministic, non-repeating fill so no kernel sees flat data
+inline void fillPattern(uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<uint8_t>(i * 131 + (i >> 9));
+    }
+}
+
+inline const char* formatName(int format) {
+    switch (format) {
+    case FORMAT_NV21: return "NV21";
+    case FORMAT_YUV420: return "I420";
+    case FORMAT_RGBA: return "RGBA";
+    case FORMAT_RGB: return "RGB";
+    case FORMAT_NV12: return "NV12";
+    default: return "?";
+    }
+}
+
+} // namespace Bench
@@ -0,0 +1,295 @@
+/*
+ * DroidFakeCam - Frame Benchmark
+ *
+ * Per-call cost of every FrameUtils entry point, FrameTransform against
+ * the same work chained from those entry points, and the decode-ahead
+ * ring handoff used by MediaReader (CPU copy and hardware buffer handle),
+ * across camera resolutions from VGA to 4K.
+ *
+ * Columns:
+ *   ns/px     time per call divided by the larger of the source and
+ *             destination pixel counts
+ *   MB/s      source bytes read plus destination bytes written, per second
+ *   allocs    heap allocations per call (global operator new, which also
+ *             catches frame pool misses)
+ *
+ * Usage: frame_bench [--quick] [--stats] [filter]
+ *   --quick   ~50 ms per case instead of ~250 ms
+ *   --stats   record PipelineStats while running (shows the probe
+ *             overhead) and print the per-stage percentiles at the end
+ *   filter    only run cases whose name contains this string
+ *
+ * For educational and research purposes only.
+ */
+
+#include "bench_common.hpp"
+#include "frame_ring.hpp"
+#include "frame_simd.hpp"
+#include "frame_transform.hpp"
+#include "frame_utils.hpp"
+#include "hardware_buffer.hpp"
+#include "pipeline_stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+void* countedAlloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) {
+        abort();
+    }
+    return ptr;
+}
+
+} // namespace
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+namespace {
+
+struct Options {
+    double minMs = 250.0;
+    const char* filter = nullptr;
+};
+
+// Time `fn` and print one result row. `src` and `dst` are only inspected
+// (after a warm-up call) for sizes; pass the same frame twice for
+// in-place operations.
+template <typename Fn>
+void run(const Options& options, const char* name, int dstFormat,
+         const FrameData& src, const FrameData& dst, Fn fn) {
+    char label[64];
+    if (dstFormat != src.format) {
+        snprintf(label, sizeof(label), "%s %s->%s", name,
+                 Bench::formatName(src.format), Bench::formatName(dstFormat));
+    } else {
+        snprintf(label, sizeof(label), "%s %s", name, Bench::formatName(src.format));
+    }
+    if (options.filter && !strstr(label, options.filter)) {
+        return;
+    }
+
+    fn();
+    uint64_t allocsBefore = g_allocations.load(std::memory_order_relaxed);
+    int iterations = 0;
+    double ms = Bench::timeMs(fn, options.minMs, &iterations);
+    uint64_t allocs = g_allocations.load(std::memory_order_relaxed) - allocsBefore;
+
+    // timeMs makes one extra warm-up call
+    double callsTimed = iterations + 1;
+    double pixels = std::max(static_cast<double>(src.width) * src.height,
+                             static_cast<double>(dst.width) * dst.height);
+    double mb = (src.size + dst.size) / (1024.0 * 1024.0);
+
+    char size[32];
+    snprintf(size, sizeof(size), "%dx%d", src.width, src.height);
+    printf("%-34s %-10s %8.3f %9.0f %7.2f\n", label, size,
+           ms * 1e6 / pixels, mb / ms * 1000.0, allocs / callsTimed);
+}
+
+void makeFrame(FrameData& frame, FrameFormat format, int width, int height) {
+    FrameUtils::PlaneLayout layout;
+    FrameUtils::prepareFrame(frame, format, width, height, layout);
+    Bench::fillPattern(frame.data, frame.size);
+}
+
+void benchResolution(const Options& options, int width, int height) {
+    FrameData rgb, rgba, nv21, i420;
+    makeFrame(rgb, FORMAT_RGB, width, height);
+    makeFrame(rgba, FORMAT_RGBA, width, height);
+    makeFrame(nv21, FORMAT_NV21, width, height);
+    makeFrame(i420, FORMAT_YUV420, width, height);
+
+    const FrameData* planar[] = {&rgb, &rgba, &nv21, &i420};
+    const FrameData* common[] = {&rgb, &rgba, &nv21};
+
+    // Downscale to 3/4, as when matching a video to a smaller preview
+    int scaledWidth = (width * 3 / 4) & ~1;
+    int scaledHeight = (height * 3 / 4) & ~1;
+
+    FrameData out;
+    for (const FrameData* src : planar) {
+        run(options, "scaleFrame", src->format, *src, out, [&] {
+            FrameUtils::scaleFrame(*src, out, scaledWidth, scaledHeight);
+        });
+    }
+
+    run(options, "convertFormat", FORMAT_NV21, rgb, out, [&] {
+        FrameUtils::convertFormat(rgb, out, FORMAT_NV21);
+    });
+    run(options, "convertFormat", FORMAT_YUV420, rgb, out, [&] {
+        FrameUtils::convertFormat(rgb, out, FORMAT_YUV420);
+    });
+    run(options, "convertFormat", FORMAT_RGB, nv21, out, [&] {
+        FrameUtils::convertFormat(nv21, out, FORMAT_RGB);
+    });
+
+    // Raw conversions write into a preallocated frame
+    FrameData nv21Out, i420Out, rgbOut;
+    makeFrame(nv21Out, FORMAT_NV21, width, height);
+    makeFrame(i420Out, FORMAT_YUV420, width, height);
+    makeFrame(rgbOut, FORMAT_RGB, width, height);
+    run(options, "rgbToNv21", nv21Out.format, rgb, nv21Out, [&] {
+        FrameUtils::rgbToNv21(rgb.data, nv21Out.data, width, height);
+    });
+    run(options, "rgbToYuv420", i420Out.format, rgb, i420Out, [&] {
+        FrameUtils::rgbToYuv420(rgb.data, i420Out.data, width, height);
+    });
+    run(options, "nv21ToRgb", rgbOut.format, nv21, rgbOut, [&] {
+        FrameUtils::nv21ToRgb(nv21.data, rgbOut.data, width, height);
+    });
+
+    // In-place operations run on a scratch copy so the inputs stay intact
+    for (const FrameData* src : common) {
+        FrameData work;
+        makeFrame(work, src->format, width, height);
+        run(options, "flipHorizontal", work.format, work, work, [&] {
+            FrameUtils::flipHorizontal(work);
+        });
+        run(options, "rotate180", work.format, work, work, [&] {
+            FrameUtils::rotate180(work);
+        });
+        run(options, "rotate90CW", src->format, *src, out, [&] {
+            FrameUtils::rotate90CW(*src, out);
+        });
+        run(options, "rotate90CCW", src->format, *src, out, [&] {
+            FrameUtils::rotate90CCW(*src, out);
+        });
+        run(options, "applyFrontCameraTransform", src->format, *src, out, [&] {
+            FrameUtils::applyFrontCameraTransform(*src, out);
+        });
+        run(options, "matchResolution 1280x960", src->format, *src, out, [&] {
+            FrameUtils::matchResolution(*src, out, 1280, 960);
+        });
+    }
+
+    // Front camera preview in one call: mirror + rotate + downscale
+    FrameTransform::Orientation front{90, true};
+    run(options, "FrameTransform front", FORMAT_NV21, nv21, out, [&] {
+        FrameTransform::apply(nv21, out, FORMAT_NV21, scaledHeight, scaledWidth, front);
+    });
+    run(options, "FrameTransform front", FORMAT_RGB, nv21, out, [&] {
+        FrameTransform::apply(nv21, out, FORMAT_RGB, scaledHeight, scaledWidth, front);
+    });
+    run(options, "FrameTransform front", FORMAT_NV21, rgb, out, [&] {
+        FrameTransform::apply(rgb, out, FORMAT_NV21, scaledHeight, scaledWidth, front);
+    });
+
+    // The same, chained from the standalone passes as a baseline
+    FrameData scaled, turned;
+    auto chained = [&](const FrameData& src, FrameFormat format) {
+        FrameUtils::scaleFrame(src, scaled, scaledWidth, scaledHeight);
+        FrameUtils::flipHorizontal(scaled);
+        FrameUtils::rotate90CW(scaled, turned);
+        FrameUtils::convertFormat(turned, out, format);
+    };
+    run(options, "Chained front", FORMAT_NV21, nv21, out, [&] {
+        chained(nv21, FORMAT_NV21);
+    });
+    run(options, "Chained front", FORMAT_RGB, nv21, out, [&] {
+        chained(nv21, FORMAT_RGB);
+    });
+    run(options, "Chained front", FORMAT_NV21, rgb, out, [&] {
+        chained(rgb, FORMAT_NV21);
+    });
+
+    // MediaReader decode-ahead path: copy a decoded frame into a ring
+    // slot, publish it, and take it on the consumer side
+    FrameRing ring(4);
+    FrameRef ref;
+    run(options, "FrameRing handoff", nv21.format, nv21, nv21, [&] {
+        FrameRing::Slot* slot = ring.beginWrite();
+        if (!slot) {
+            return;
+        }
+        memcpy(slot->prepare(nv21.size), nv21.data, nv21.size);
+        slot->size = nv21.size;
+        slot->width = width;
+        slot->height = height;
+        slot->format = nv21.format;
+        slot->stride = width;
+        ring.commitWrite(slot);
+        ring.pop(ref);
+    });
+
+    // Same handoff with hardware buffer output: the decoder hands over a
+    // (stand-in) buffer handle and the consumer maps it instead of copying
+    HardwareBuffer* hardware = HardwareBuffer::allocate(width, height, FORMAT_NV21);
+    memcpy(hardware->nativeHandle(), nv21.data, nv21.size);
+    run(options, "FrameRing hardware handoff", nv21.format, nv21, nv21, [&] {
+        FrameRing::Slot* slot = ring.beginWrite();
+        if (!slot) {
+            return;
+        }
+        slot->attach(hardware);
+        slot->width = width;
+        slot->height = height;
+        slot->format = nv21.format;
+        slot->stride = width;
+        ring.commitWrite(slot);
+        ring.pop(ref);
+
+        FrameData mapped;
+        if (ref.hardwareBuffer()->lock(mapped)) {
+            ref.hardwareBuffer()->unlock();
+        }
+    });
+    ref.reset();
+    hardware->release();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            options.minMs = 50.0;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            PipelineStats::setEnabled(true);
+        } else {
+            options.filter = argv[i];
+        }
+    }
+
+    const int resolutions[][2] = {
+        {640, 480},
+        {1280, 720},
+        {1920, 1080},
+        {3840, 2160},
+    };
+
+    printf("frame kernels: %s\n", FrameSimd::isaName(FrameSimd::best().isa));
+    printf("%-34s %-10s %8s %9s %7s\n", "case", "source", "ns/px", "MB/s", "allocs");
+    for (const auto& resolution : resolutions) {
+        benchResolution(options, resolution[0], resolution[1]);
+    }
+
+    if (PipelineStats::isEnabled()) {
+        printf("\n%-10s %10s %10s %10s %10s %10s\n", "stage", "samples",
+               "p50 us", "p95 us", "p99 us", "max us");
+        for (int i = 0; i < PipelineStats::STAGE_COUNT; i++) {
+            auto stage = static_cast<PipelineStats::Stage>(i);
+            PipelineStats::StageSummary s = PipelineStats::getSummary(stage);
+            printf("%-10s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+                   PipelineStats::stageName(stage), (unsigned long long)s.count,
+                   s.p50Ns / 1000.0, s.p95Ns / 1000.0, s.p99Ns / 1000.0, s.maxNs / 1000.0);
+        }
+    }
+    return 0;
+}
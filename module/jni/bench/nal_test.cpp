@@ -0,0 +1,143 @@
+/*
+ * DroidFakeCam - NAL Parser Test
+ *
+ * Which samples NalParser lets the decoder leave out, for H.264 and for
+ * temporally layered H.265 streams, with start codes and with length
+ * prefixes. Exits non-zero on the first wrong answer.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "nal_parser.hpp"
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+// H.265 NAL header for `type` with TemporalId `temporalId`, then a byte
+// of payload
+std::vector<uint8_t> hevcNal(int type, int temporalId) {
+    return {static_cast<uint8_t>(type << 1), static_cast<uint8_t>(temporalId + 1), 0xAA};
+}
+
+// Sample holding `nals`, with 4-byte start codes or big-endian lengths
+std::vector<uint8_t> sample(const std::vector<std::vector<uint8_t>>& nals, bool startCodes) {
+    std::vector<uint8_t> out;
+    for (const std::vector<uint8_t>& nal : nals) {
+        size_t n = nal.size();
+        if (startCodes) {
+            out.insert(out.end(), {0, 0, 0, 1});
+        } else {
+            out.insert(out.end(), {static_cast<uint8_t>(n >> 24), static_cast<uint8_t>(n >> 16),
+                                   static_cast<uint8_t>(n >> 8), static_cast<uint8_t>(n)});
+        }
+        out.insert(out.end(), nal.begin(), nal.end());
+    }
+    return out;
+}
+
+bool disposable(NalParser::Syntax syntax, int highest, const std::vector<uint8_t>& data) {
+    return NalParser::isDisposableSample(syntax, highest, data.data(), data.size());
+}
+
+// H.265 NAL unit types
+constexpr int TRAIL_N = 0;
+constexpr int TRAIL_R = 1;
+constexpr int TSA_N = 2;
+constexpr int RASL_N = 8;
+constexpr int IDR_W_RADL = 19;
+constexpr int SPS = 33;
+constexpr int SEI = 39;
+
+void testAvc() {
+    const NalParser::Syntax avc = NalParser::SYNTAX_AVC;
+    for (int startCodes = 0; startCodes < 2; startCodes++) {
+        // nal_ref_idc 0 non-IDR slice, with an SEI in front
+        expect(disposable(avc, -1, sample({{0x06, 0x05, 0x01}, {0x01, 0x88}}, startCodes)),
+               "AVC non-reference slice is disposable");
+        expect(!disposable(avc, -1, sample({{0x21, 0x88}}, startCodes)),
+               "AVC reference slice is kept");
+        expect(!disposable(avc, -1, sample({{0x65, 0x88}}, startCodes)),
+               "AVC IDR slice is kept");
+        expect(!disposable(avc, -1, sample({{0x01, 0x88}, {0x21, 0x88}}, startCodes)),
+               "AVC sample with any reference slice is kept");
+        expect(!disposable(avc, -1, sample({{0x06, 0x05, 0x01}}, startCodes)),
+               "AVC sample without slices is kept");
+    }
+}
+
+void testHevcLayers() {
+    const NalParser::Syntax hevc = NalParser::SYNTAX_HEVC;
+
+    // Three sub-layers (TemporalId 0..2), as in high frame rate recordings
+    std::vector<uint8_t> sps = hevcNal(SPS, 0);
+    sps[2] = 2 << 1;  // sps_video_parameter_set_id 0, sps_max_sub_layers_minus1 2
+    for (int startCodes = 0; startCodes < 2; startCodes++) {
+        std::vector<uint8_t> config = sample({hevcNal(32, 0), sps, hevcNal(34, 0)}, startCodes);
+        int highest = NalParser::hevcHighestTemporalId(config.data(), config.size());
+        expect(highest == 2, "Highest TemporalId read from SPS");
+
+        expect(disposable(hevc, highest, sample({hevcNal(TRAIL_N, 2)}, startCodes)),
+               "TRAIL_N in the top sub-layer is disposable");
+        expect(disposable(hevc, highest, sample({hevcNal(SEI, 2), hevcNal(RASL_N, 2)},
+                                                startCodes)),
+               "RASL_N in the top sub-layer is disposable");
+        expect(!disposable(hevc, highest, sample({hevcNal(TRAIL_N, 0)}, startCodes)),
+               "TRAIL_N in sub-layer 0 is referenced from above");
+        expect(!disposable(hevc, highest, sample({hevcNal(TSA_N, 1)}, startCodes)),
+               "TSA_N in sub-layer 1 is referenced from above");
+        expect(!disposable(hevc, highest, sample({hevcNal(TRAIL_R, 2)}, startCodes)),
+               "TRAIL_R is kept");
+        expect(!disposable(hevc, highest, sample({hevcNal(IDR_W_RADL, 0)}, startCodes)),
+               "IDR is kept");
+
+        // Unknown layering: nothing is safe to leave out
+        expect(!disposable(hevc, -1, sample({hevcNal(TRAIL_N, 0)}, startCodes)),
+               "TRAIL_N kept when the sub-layer count is unknown");
+    }
+
+    // Single layer stream: every _N picture is in the top sub-layer
+    std::vector<uint8_t> single = sample({hevcNal(SPS, 0)}, true);
+    single.back() = 0;
+    int highest = NalParser::hevcHighestTemporalId(single.data(), single.size());
+    expect(highest == 0, "Single sub-layer SPS");
+    expect(disposable(hevc, highest, sample({hevcNal(TRAIL_N, 0)}, true)),
+           "TRAIL_N of a single layer stream is disposable");
+
+    std::vector<uint8_t> noSps = sample({hevcNal(32, 0), hevcNal(34, 0)}, true);
+    expect(NalParser::hevcHighestTemporalId(noSps.data(), noSps.size()) == -1,
+           "No SPS, no highest TemporalId");
+}
+
+void testMalformed() {
+    // Length prefix running past the end of the sample
+    std::vector<uint8_t> data = sample({{0x01, 0x88}}, false);
+    data[3] = 0x40;
+    expect(!disposable(NalParser::SYNTAX_AVC, -1, data), "Truncated sample is kept");
+    expect(!disposable(NalParser::SYNTAX_UNKNOWN, -1, sample({{0x01, 0x88}}, true)),
+           "Unknown syntax is kept");
+}
+
+} // namespace
+
+int main() {
+    testAvc();
+    testHevcLayers();
+    testMalformed();
+
+    if (g_failures > 0) {
+        std::printf("%d failures\n", g_failures);
+        return 1;
+    }
+    std::printf("NAL parser: all passed\n");
+    return 0;
+}
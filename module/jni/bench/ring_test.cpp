@@ -0,0 +1,167 @@
+/*
+ * DroidFakeCam - Frame Ring Test
+ *
+ * FrameRing bookkeeping, single threaded: frames come out in order
+ * across many trips around the slots, slow consumers get the newest
+ * frame, due positions are honoured, pinned slots are never recycled and
+ * a FrameRef outlives its slot's reuse. Exits non-zero on the first
+ * wrong answer.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_ring.hpp"
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+int g_failures = 0;
+
+void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+constexpr size_t kFrameBytes = 64;
+
+// Publish a frame whose timestamp, position and every pixel byte are `n`
+FrameRing::Slot* publish(FrameRing& ring, int n) {
+    FrameRing::Slot* slot = ring.beginWrite();
+    if (!slot) {
+        return nullptr;
+    }
+    memset(slot->prepare(kFrameBytes), n & 0xff, kFrameBytes);
+    slot->width = 8;
+    slot->height = 8;
+    slot->timestamp = n;
+    slot->position = n;
+    ring.commitWrite(slot);
+    return slot;
+}
+
+bool holds(const FrameRef& frame, int n) {
+    if (frame.timestamp != n || !frame.data() || frame.size != kFrameBytes) {
+        return false;
+    }
+    for (size_t i = 0; i < kFrameBytes; i++) {
+        if (frame.data()[i] != (n & 0xff)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testWrapAround() {
+    FrameRing ring(3);
+    FrameRef frame;
+    expect(!ring.pop(frame), "Empty ring has nothing to pop");
+
+    // Many times around the slots, one frame in and one out
+    bool inOrder = true;
+    for (int n = 1; n <= 100; n++) {
+        bool fresh = false;
+        inOrder = inOrder && publish(ring, n) && ring.pop(frame, &fresh) &&
+                  fresh && holds(frame, n);
+    }
+    expect(inOrder, "Frames come out in order across wrap-around");
+
+    bool fresh = true;
+    expect(ring.pop(frame, &fresh) && !fresh && holds(frame, 100),
+           "Last frame repeated when nothing new is ready");
+
+    // Producer stops at the depth, a slow consumer takes the newest
+    int n = 101;
+    while (publish(ring, n)) {
+        n++;
+    }
+    expect(n - 101 == ring.getDepth(), "Producer fills the ring up to its depth");
+    expect(ring.pending() == ring.getDepth(), "Full ring reports depth pending");
+    expect(ring.pop(frame, &fresh) && fresh && holds(frame, n - 1),
+           "Slow consumer gets the newest frame");
+    expect(ring.pending() == 0, "Frames passed over are freed");
+
+    // Dropped frames: the newest stale one is repeated until a new one
+    // arrives
+    publish(ring, n);
+    expect(ring.flush() == 1, "Flush drops the unconsumed frame");
+    expect(ring.pop(frame, &fresh) && !fresh && holds(frame, n),
+           "Stale frame repeated after a flush");
+    publish(ring, n + 1);
+    expect(ring.pop(frame, &fresh) && fresh && holds(frame, n + 1),
+           "First frame after a flush is taken");
+}
+
+void testDue() {
+    FrameRing ring(4);
+    FrameRef frame;
+    for (int n = 10; n <= 40; n += 10) {
+        publish(ring, n);
+    }
+
+    int advanced = -1;
+    expect(ring.popDue(frame, 5, &advanced) && holds(frame, 10) && advanced == 1,
+           "First frame is taken even if early");
+    expect(ring.popDue(frame, 15, &advanced) && holds(frame, 10) && advanced == 0,
+           "Frame repeated until the next one is due");
+    expect(ring.popDue(frame, 35, &advanced) && holds(frame, 30) && advanced == 2,
+           "Newest due frame taken, the one before skipped");
+
+    int64_t position = 0;
+    expect(ring.nextPosition(&position) && position == 40, "Position of the next frame");
+}
+
+void testPins() {
+    // Depth 2: four slots
+    FrameRing ring(2);
+    FrameRef frame;
+    FrameRing::Slot* a = publish(ring, 1);
+    ring.pop(frame);
+    FrameRing::Slot* b = publish(ring, 2);
+    publish(ring, 3);
+    ring.pop(frame);
+
+    // A reader still holds slots A and B pinned
+    a->pins.store(1);
+    b->pins.store(1);
+    FrameRing::Slot* d = publish(ring, 4);
+    expect(d && d != a && d != b, "Pinned slots are not recycled");
+    ring.pop(frame);
+    FrameRing::Slot* e = publish(ring, 5);
+    expect(e && e != a && e != b, "Pinned slots are still not recycled");
+    expect(!ring.beginWrite(), "No slot while every recyclable one is pinned");
+
+    a->pins.store(0);
+    FrameRing::Slot* f = ring.beginWrite();
+    expect(f == a, "Slot recycled once unpinned");
+    if (f) {
+        ring.abortWrite(f);
+    }
+    b->pins.store(0);
+
+    // A consumer's FrameRef keeps its pixels through the slot's reuse
+    FrameRef held;
+    expect(ring.pop(held) && holds(held, 5), "Newest frame taken");
+    for (int n = 6; n < 20; n++) {
+        publish(ring, n);
+        ring.pop(frame);
+    }
+    expect(holds(held, 5), "Held frame untouched after its slot is reused");
+}
+
+} // namespace
+
+int main() {
+    testWrapAround();
+    testDue();
+    testPins();
+
+    if (g_failures > 0) {
+        std::printf("%d failures\n", g_failures);
+        return 1;
+    }
+    std::printf("Frame ring: all passed\n");
+    return 0;
+}
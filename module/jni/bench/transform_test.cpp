@@ -0,0 +1,119 @@
+/*
+ * DroidFakeCam - Frame Transform Test
+ *
+ * FrameTransform::apply against the same work done as separate passes
+ * (scaleFrame, flipHorizontal, rotate90CW/rotate90CCW/rotate180, then
+ * convertFormat), for every orientation, scaling up, down and not at
+ * all, in and across formats. The outputs must match byte for byte.
+ * Exits non-zero on the first mismatch.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "bench_common.hpp"
+#include "frame_transform.hpp"
+#include "frame_utils.hpp"
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+int g_failures = 0;
+
+void makeFrame(FrameData& frame, FrameFormat format, int width, int height) {
+    FrameUtils::PlaneLayout layout;
+    FrameUtils::prepareFrame(frame, format, width, height, layout);
+    Bench::fillPattern(frame.data, frame.size);
+}
+
+// apply() done the long way
+bool chain(const FrameData& src, FrameData& dst, FrameFormat format,
+           int width, int height, FrameTransform::Orientation orientation) {
+    bool turned = orientation.rotation == 90 || orientation.rotation == 270;
+    FrameData scaled;
+    if (!FrameUtils::scaleFrame(src, scaled, turned ? height : width,
+                                turned ? width : height)) {
+        return false;
+    }
+    if (orientation.mirror) {
+        FrameUtils::flipHorizontal(scaled);
+    }
+
+    FrameData oriented;
+    if (orientation.rotation == 90) {
+        FrameUtils::rotate90CW(scaled, oriented);
+    } else if (orientation.rotation == 270) {
+        FrameUtils::rotate90CCW(scaled, oriented);
+    } else {
+        if (orientation.rotation == 180) {
+            FrameUtils::rotate180(scaled);
+        }
+        oriented = std::move(scaled);
+    }
+    return FrameUtils::convertFormat(oriented, dst, format);
+}
+
+void check(const FrameData& src, FrameFormat format, int width, int height,
+           FrameTransform::Orientation orientation) {
+    FrameData expected;
+    FrameData actual;
+    bool chained = chain(src, expected, format, width, height, orientation);
+    bool applied = FrameTransform::apply(src, actual, format, width, height, orientation);
+    if (chained && applied && expected.size == actual.size &&
+        memcmp(expected.data, actual.data, expected.size) == 0) {
+        return;
+    }
+    printf("FAIL: %s %dx%d -> %s %dx%d, rotation %d%s\n",
+           Bench::formatName(src.format), src.width, src.height,
+           Bench::formatName(format), width, height, orientation.rotation,
+           orientation.mirror ? " mirrored" : "");
+    g_failures++;
+}
+
+} // namespace
+
+int main() {
+    // Source format, target format
+    const FrameFormat conversions[][2] = {
+        {FORMAT_RGB, FORMAT_RGB},
+        {FORMAT_RGBA, FORMAT_RGBA},
+        {FORMAT_NV21, FORMAT_NV21},
+        {FORMAT_NV12, FORMAT_NV12},
+        {FORMAT_YUV420, FORMAT_YUV420},
+        {FORMAT_RGB, FORMAT_NV21},
+        {FORMAT_RGB, FORMAT_YUV420},
+        {FORMAT_NV21, FORMAT_RGB},
+    };
+    // Oriented target sizes for a 64x48 source: as is, down, up, and
+    // squashed on one axis
+    const int sizes[][2] = {
+        {64, 48},
+        {48, 64},
+        {40, 30},
+        {90, 70},
+        {64, 20},
+    };
+
+    int cases = 0;
+    for (const auto& conversion : conversions) {
+        FrameData src;
+        makeFrame(src, conversion[0], 64, 48);
+        for (const auto& size : sizes) {
+            for (int rotation = 0; rotation < 360; rotation += 90) {
+                for (int mirror = 0; mirror < 2; mirror++) {
+                    check(src, conversion[1], size[0], size[1],
+                          FrameTransform::Orientation{rotation, mirror != 0});
+                    cases++;
+                }
+            }
+        }
+    }
+
+    if (g_failures > 0) {
+        printf("%d of %d cases failed\n", g_failures, cases);
+        return 1;
+    }
+    printf("Frame transform: %d cases passed\n", cases);
+    return 0;
+}
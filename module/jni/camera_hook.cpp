@@ -14,17 +14,33 @@
 
 #include "camera_hook.hpp"
 #include "config.hpp"
+#include "frame_buffer.hpp"
+#include "frame_pool.hpp"
+#include "frame_transform.hpp"
 #include "frame_utils.hpp"
+#include "hardware_buffer.hpp"
+#include "image_frame_map.hpp"
 #include "media_reader.hpp"
+#include "media_watcher.hpp"
+#include "output_plan.hpp"
+#include "pipeline_stats.hpp"
 
 #include <dlfcn.h>
 #include <android/log.h>
 #include <android/native_window.h>
+#include <media/NdkImage.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <string>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 #define LOG_TAG "DroidFakeCam"
 #define LOGI(...) if (!Config::shouldSuppressLogs()) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -37,10 +53,248 @@ namespace CameraHook {
 static std::string g_appName;
 static bool g_initialized = false;
 static MediaReader* g_videoReader = nullptr;
-static MediaReader* g_photoReader = nullptr;
+// Shared so the acquire hook can convert the photo outside g_mutex while
+// a reload swaps the reader out
+static std::shared_ptr<MediaReader> g_photoReader;
 static std::mutex g_mutex;
 static HookStatus g_status = {};
 
+// Conversion plans of the registered output surfaces (guarded by g_mutex)
+static std::vector<OutputPlan> g_outputPlans;
+
+// AImageReader behind each surface the app got from AImageReader_getWindow
+// (guarded by g_mutex). Only these surfaces get plans; frames for the
+// others (previews, encoders) never pass through the hooks.
+static std::map<void*, void*> g_readerWindows;
+
+// Smaller renditions of the video source (virtual_480.mp4, ...), smallest
+// first. Each output takes frames from the smallest one that covers it;
+// a rendition's reader is only open while a registered output uses it.
+// Guarded by g_mutex.
+struct VideoRendition {
+    std::string path;
+    int width;
+    int height;
+    MediaReader* reader;
+};
+static std::vector<VideoRendition> g_renditions;
+
+static MediaReader* openVideoReader(const std::string& path, bool warmUp, int64_t startUs = -1);
+
+// Index of the smallest rendition covering a width x height output in
+// either orientation, -1 if only the full video does. Called with
+// g_mutex held.
+static int selectRendition(int width, int height) {
+    int outputShort = std::min(width, height);
+    int outputLong = std::max(width, height);
+    for (size_t i = 0; i < g_renditions.size(); i++) {
+        const VideoRendition& rendition = g_renditions[i];
+        if (std::min(rendition.width, rendition.height) >= outputShort &&
+            std::max(rendition.width, rendition.height) >= outputLong) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Reader for a width x height output: its rendition if that is open,
+// else the full video. Called with g_mutex held.
+static MediaReader* videoReaderFor(int width, int height) {
+    int index = selectRendition(width, height);
+    if (index >= 0 && g_renditions[index].reader && g_renditions[index].reader->isReady()) {
+        return g_renditions[index].reader;
+    }
+    return g_videoReader;
+}
+
+// Open the rendition a width x height output uses, unless it is open
+// already. It starts at the frame the full video is showing and plays on
+// its clock, so every output shows the same moment of the video. Runs on
+// the rendition worker, without g_mutex.
+static void openRendition(int width, int height) {
+    std::string path;
+    MediaReader* leader;
+    int64_t startUs;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        int index = selectRendition(width, height);
+        if (index < 0 || g_renditions[index].reader || !g_videoReader) {
+            return;
+        }
+        path = g_renditions[index].path;
+        leader = g_videoReader;
+        startUs = leader->getCurrentPosition();
+    }
+    
+    MediaReader* reader = openVideoReader(path, true, startUs);
+    if (!reader) {
+        LOGE("Failed to open rendition %s", path.c_str());
+        return;
+    }
+    {
+        // The leader is only known to be alive while it is still the source
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (VideoRendition& rendition : g_renditions) {
+            if (g_videoReader == leader && rendition.path == path && !rendition.reader) {
+                if (!reader->shareClock(leader)) {
+                    LOGE("Rendition %s loops differently, playing on its own clock",
+                         path.c_str());
+                }
+                rendition.reader = reader;
+                reader = nullptr;
+                break;
+            }
+        }
+    }
+    if (reader) {
+        // Opened by another output meanwhile, or the source was replaced
+        delete reader;
+    } else {
+        LOGI("Rendition opened for %dx%d output: %s", width, height, path.c_str());
+    }
+}
+
+// Outputs whose renditions are waiting to be opened, and whether a
+// worker thread is opening them. Guarded by g_mutex.
+static std::vector<std::pair<int, int>> g_renditionRequests;
+static bool g_renditionWorkerBusy = false;
+static std::condition_variable g_renditionWorkerIdle;
+
+// Worker: open the requested renditions one after another, then exit
+static void openRequestedRenditions() {
+    pthread_setname_np(pthread_self(), "dfc-rendition");
+    for (;;) {
+        std::pair<int, int> output;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            if (g_renditionRequests.empty()) {
+                g_renditionWorkerBusy = false;
+                g_renditionWorkerIdle.notify_all();
+                return;
+            }
+            output = g_renditionRequests.front();
+            g_renditionRequests.erase(g_renditionRequests.begin());
+        }
+        openRendition(output.first, output.second);
+    }
+}
+
+// Have the rendition a width x height output uses opened off the calling
+// thread; the output plays the full video until it is ready. Called with
+// g_mutex held.
+static void requestRendition(int width, int height) {
+    int index = selectRendition(width, height);
+    if (index < 0 || g_renditions[index].reader) {
+        return;
+    }
+    g_renditionRequests.emplace_back(width, height);
+    if (!g_renditionWorkerBusy) {
+        g_renditionWorkerBusy = true;
+        std::thread(openRequestedRenditions).detach();
+    }
+}
+
+// Close the renditions no registered output uses. Runs without g_mutex.
+static void closeUnusedRenditions() {
+    std::vector<MediaReader*> unused;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        std::vector<bool> used(g_renditions.size(), false);
+        for (const OutputPlan& plan : g_outputPlans) {
+            int index = selectRendition(plan.width, plan.height);
+            if (index >= 0) {
+                used[index] = true;
+            }
+        }
+        for (size_t i = 0; i < g_renditions.size(); i++) {
+            if (!used[i] && g_renditions[i].reader) {
+                unused.push_back(g_renditions[i].reader);
+                g_renditions[i].reader = nullptr;
+            }
+        }
+    }
+    for (MediaReader* reader : unused) {
+        delete reader;
+    }
+}
+
+// Renditions of `videoPath` with their sizes, smallest first, leaving out
+// any that aren't smaller than the video itself. Without the video the
+// largest rendition takes its place (and `videoPath` is changed to it).
+static std::vector<VideoRendition> findRenditions(std::string& videoPath) {
+    std::vector<VideoRendition> renditions;
+    for (const std::string& path : Config::getVideoRenditions(videoPath)) {
+        VideoRendition rendition = {path, 0, 0, nullptr};
+        if (MediaReader::probeVideoSize(path, &rendition.width, &rendition.height)) {
+            renditions.push_back(rendition);
+        }
+    }
+    std::sort(renditions.begin(), renditions.end(),
+              [](const VideoRendition& a, const VideoRendition& b) {
+                  return a.width * a.height < b.width * b.height;
+              });
+    
+    int fullWidth = 0;
+    int fullHeight = 0;
+    if (!Config::fileExists(videoPath.c_str())) {
+        if (renditions.empty()) {
+            return renditions;
+        }
+        videoPath = renditions.back().path;
+        fullWidth = renditions.back().width;
+        fullHeight = renditions.back().height;
+        renditions.pop_back();
+    } else if (!MediaReader::probeVideoSize(videoPath, &fullWidth, &fullHeight)) {
+        return renditions;
+    }
+    
+    renditions.erase(std::remove_if(renditions.begin(), renditions.end(),
+                                    [&](const VideoRendition& rendition) {
+                                        return rendition.width * rendition.height >=
+                                               fullWidth * fullHeight;
+                                    }),
+                     renditions.end());
+    return renditions;
+}
+
+// Reloads sources when files in the media directory change
+static MediaWatcher g_mediaWatcher;
+
+// Re-reads the control files instead when the watcher can't run (no
+// inotify, no media directory yet)
+static std::thread g_configPoller;
+static std::mutex g_configPollerMutex;
+static std::condition_variable g_configPollerWake;
+static bool g_configPollerStop = false;
+
+static void startConfigPoller() {
+    g_configPollerStop = false;
+    g_configPoller = std::thread([] {
+        std::unique_lock<std::mutex> lock(g_configPollerMutex);
+        while (!g_configPollerWake.wait_for(lock,
+                                            std::chrono::milliseconds(Config::REFRESH_INTERVAL_MS),
+                                            [] { return g_configPollerStop; })) {
+            Config::refresh();
+        }
+    });
+}
+
+static void stopConfigPoller() {
+    if (!g_configPoller.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_configPollerMutex);
+        g_configPollerStop = true;
+    }
+    g_configPollerWake.notify_all();
+    g_configPoller.join();
+}
+
+// Longest a replacement video may take to decode its first frame before
+// it goes live anyway
+static constexpr int VIDEO_WARMUP_MS = 1000;
+
 // Original function pointers
 typedef void (*ACameraCaptureSession_captureCallback_result)(
     void* context,
@@ -63,6 +317,50 @@ static void* g_original_functions[16] = {nullptr};
 // Native hooks using PLT hooking (to be registered via Zygisk API)
 // These will intercept camera frame delivery
 
+// AImageReader_getWindow hook: remember which reader a surface belongs to
+typedef int (*AImageReader_getWindow_t)(void* reader, void** window);
+static AImageReader_getWindow_t original_AImageReader_getWindow = nullptr;
+
+int hooked_AImageReader_getWindow(void* reader, void** window) {
+    int result = 0;
+    if (original_AImageReader_getWindow) {
+        result = original_AImageReader_getWindow(reader, window);
+    }
+    
+    if (result == 0 && window && *window) {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_readerWindows[*window] = reader;
+    }
+    return result;
+}
+
+// AImageReader_delete hook: forget the reader's surface and its plans
+typedef void (*AImageReader_delete_t)(void* reader);
+static AImageReader_delete_t original_AImageReader_delete = nullptr;
+
+void hooked_AImageReader_delete(void* reader) {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (auto it = g_readerWindows.begin(); it != g_readerWindows.end();) {
+            if (it->second == reader) {
+                it = g_readerWindows.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        g_outputPlans.erase(std::remove_if(g_outputPlans.begin(), g_outputPlans.end(),
+                                           [reader](const OutputPlan& plan) {
+                                               return plan.reader == reader;
+                                           }),
+                            g_outputPlans.end());
+    }
+    closeUnusedRenditions();
+    
+    if (original_AImageReader_delete) {
+        original_AImageReader_delete(reader);
+    }
+}
+
 // ACameraOutputTarget_create hook
 typedef int (*ACameraOutputTarget_create_t)(void* window, void** output);
 static ACameraOutputTarget_create_t original_ACameraOutputTarget_create = nullptr;
@@ -70,7 +368,6 @@ static ACameraOutputTarget_create_t original_ACameraOutputTarget_create = nullpt
 int hooked_ACameraOutputTarget_create(void* window, void** output) {
     LOGD("ACameraOutputTarget_create hooked, window=%p", window);
     
-    // Store the window reference for later frame injection
     // Call original function
     int result = 0;
     if (original_ACameraOutputTarget_create) {
@@ -78,9 +375,87 @@ int hooked_ACameraOutputTarget_create(void* window, void** output) {
     }
     
     LOGD("ACameraOutputTarget_create result=%d, output=%p", result, output ? *output : nullptr);
+    
+    // Plan the conversion for this surface now, so its first frame
+    // doesn't pay for scaler tables and buffers
+    if (result == 0 && window && output && *output) {
+        ANativeWindow* surface = static_cast<ANativeWindow*>(window);
+        int32_t width = ANativeWindow_getWidth(surface);
+        int32_t height = ANativeWindow_getHeight(surface);
+        int32_t format = ANativeWindow_getFormat(surface);
+        
+        std::lock_guard<std::mutex> lock(g_mutex);
+        auto owner = g_readerWindows.find(window);
+        OutputPlan plan;
+        if (owner == g_readerWindows.end()) {
+            LOGD("Output %p (%dx%d) is not an image reader's surface",
+                 *output, width, height);
+        } else if (plan.init(*output, owner->second, width, height, format)) {
+            // Decode a rendition close to this size if there is one. Its
+            // decoder starts in the background; this is the app's session
+            // setup thread.
+            requestRendition(width, height);
+            MediaReader* reader = videoReaderFor(width, height);
+            if (reader && reader->isReady()) {
+                plan.prepare(reader->getWidth(), reader->getHeight());
+            }
+            g_outputPlans.push_back(plan);
+        } else {
+            LOGD("Output %p (%dx%d, format 0x%x) can't be injected",
+                 *output, width, height, format);
+        }
+    }
     return result;
 }
 
+// ACameraOutputTarget_free hook
+typedef void (*ACameraOutputTarget_free_t)(void* output);
+static ACameraOutputTarget_free_t original_ACameraOutputTarget_free = nullptr;
+
+void hooked_ACameraOutputTarget_free(void* output) {
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (size_t i = 0; i < g_outputPlans.size(); i++) {
+            if (g_outputPlans[i].target == output) {
+                g_outputPlans.erase(g_outputPlans.begin() + i);
+                break;
+            }
+        }
+    }
+    closeUnusedRenditions();
+    
+    if (original_ACameraOutputTarget_free) {
+        original_ACameraOutputTarget_free(output);
+    }
+}
+
+// Plan for `reader`'s images of this size and format, prepared for a
+// srcWidth x srcHeight source. Images from surfaces registered before the
+// hooks were in place get a plan on first sight, dropped with the reader.
+// Called with g_mutex held.
+static bool findOutputPlan(void* reader, int width, int height, int32_t imageFormat,
+                           int srcWidth, int srcHeight, OutputPlan& plan) {
+    OutputPlan* found = nullptr;
+    for (OutputPlan& candidate : g_outputPlans) {
+        if (candidate.reader == reader && candidate.matches(width, height, imageFormat)) {
+            found = &candidate;
+            break;
+        }
+    }
+    if (!found) {
+        OutputPlan created;
+        if (!created.init(nullptr, reader, width, height, imageFormat)) {
+            return false;
+        }
+        g_outputPlans.push_back(created);
+        found = &g_outputPlans.back();
+    }
+    
+    found->prepare(srcWidth, srcHeight);
+    plan = *found;
+    return true;
+}
+
 // ACameraCaptureSession_capture hook
 typedef int (*ACameraCaptureSession_capture_t)(
     void* session, void* callbacks, int numRequests, 
@@ -105,6 +480,32 @@ int hooked_ACameraCaptureSession_capture(
     return result;
 }
 
+// Frames prepared for acquired images, each in its image's size and a
+// format whose planes map 1:1 onto the image's planes
+static ImageFrameMap g_imageFrames;
+
+// Scale, orient and convert `frame` into `prepared` as `plan` says
+static bool prepareInjection(const FrameRef& frame, const OutputPlan& plan,
+                             FrameData& prepared) {
+    FrameData source;
+    HardwareBuffer* hardware = frame.hardwareBuffer();
+    if (hardware) {
+        if (!hardware->lock(source)) {
+            return false;
+        }
+    } else {
+        frame.view(source);
+    }
+    
+    bool ok = FrameTransform::apply(source, prepared, plan.format,
+                                    plan.width, plan.height, plan.orientation);
+    source.release();
+    if (hardware) {
+        hardware->unlock();
+    }
+    return ok;
+}
+
 // Hook into the ImageReader to intercept acquired images
 typedef int (*AImageReader_acquireNextImage_t)(void* reader, void** image);
 static AImageReader_acquireNextImage_t original_AImageReader_acquireNextImage = nullptr;
@@ -117,17 +518,70 @@ int hooked_AImageReader_acquireNextImage(void* reader, void** image) {
         result = original_AImageReader_acquireNextImage(reader, image);
     }
     
-    // If we got an image and have a custom source, replace the frame data
+    // If we got an image and have a custom source, prepare its replacement
+    // now so the plane reads that follow only copy
     if (result == 0 && image && *image) {
-        std::lock_guard<std::mutex> lock(g_mutex);
-        if (g_videoReader && g_videoReader->isReady()) {
-            // Get the next frame from our video source
-            FrameData frame;
-            if (g_videoReader->getNextFrame(frame)) {
-                // Replace image data with our frame
-                LOGD("Replacing frame: %dx%d, format=%d", 
-                     frame.width, frame.height, frame.format);
-                g_status.frameCount++;
+        const AImage* acquired = static_cast<const AImage*>(*image);
+        int32_t width = 0;
+        int32_t height = 0;
+        int32_t imageFormat = 0;
+        AImage_getWidth(acquired, &width);
+        AImage_getHeight(acquired, &height);
+        AImage_getFormat(acquired, &imageFormat);
+        
+        FrameRef frame;
+        OutputPlan plan;
+        std::shared_ptr<MediaReader> photoReader;
+        bool hasSource = false;
+        bool planned = false;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            MediaReader* videoReader = videoReaderFor(width, height);
+            if (videoReader && videoReader->isReady()) {
+                hasSource = true;
+                // Get the next frame from our video source (shared, not copied)
+                if (videoReader->getNextFrame(frame)) {
+                    g_status.frameCount++;
+                    planned = findOutputPlan(reader, width, height, imageFormat,
+                                             frame.width, frame.height, plan);
+                }
+            } else if (g_photoReader && g_photoReader->isReady()) {
+                hasSource = true;
+                if (findOutputPlan(reader, width, height, imageFormat,
+                                   g_photoReader->getWidth(),
+                                   g_photoReader->getHeight(), plan)) {
+                    g_status.frameCount++;
+                    photoReader = g_photoReader;
+                }
+            }
+        }
+        
+        // The photo is converted for this plan (or found in the cache)
+        // outside the lock as well, so preparing the image is a plain copy
+        if (photoReader) {
+            planned = photoReader->getPhotoFrame(frame, plan.format, plan.width,
+                                                 plan.height, plan.orientation);
+            plan.orientation = {0, false};
+        }
+        
+        // Converted outside the lock so streams on other threads don't
+        // wait for each other
+        if (hasSource) {
+            FrameData* prepared = planned ? g_imageFrames.insert(*image) : nullptr;
+            if (prepared && prepareInjection(frame, plan, *prepared)) {
+                g_imageFrames.publish(*image);
+                LOGD("Replacing frame: %dx%d, format=%d, hardware=%p", 
+                     frame.width, frame.height, frame.format,
+                     frame.hardwareBuffer() ? frame.hardwareBuffer()->nativeHandle() : nullptr);
+            } else {
+                if (prepared) {
+                    g_imageFrames.abandon(*image);
+                } else if (planned) {
+                    LOGE("No free entry for image %p (%d images in flight)",
+                         *image, g_imageFrames.size());
+                }
+                // A source is configured but the app sees the real camera
+                PipelineStats::recordDrop(PipelineStats::DROP_INJECT);
             }
         }
     }
@@ -140,10 +594,6 @@ typedef int (*AImage_getPlaneData_t)(void* image, int planeIdx,
                                       uint8_t** data, int* dataLength);
 static AImage_getPlaneData_t original_AImage_getPlaneData = nullptr;
 
-// Storage for injected frame data
-static uint8_t* g_injectedFrame = nullptr;
-static int g_injectedFrameSize = 0;
-
 int hooked_AImage_getPlaneData(void* image, int planeIdx, 
                                 uint8_t** data, int* dataLength) {
     // First call original to get the real data location
@@ -152,22 +602,49 @@ int hooked_AImage_getPlaneData(void* image, int planeIdx,
         result = original_AImage_getPlaneData(image, planeIdx, data, dataLength);
     }
     
-    // If successful and we have a replacement frame, inject it
-    // Note: Mutex protection ensures thread-safe access to global frame storage
+    // If successful and this image has a replacement, write the matching
+    // plane in the image's own row and pixel stride (once per image)
     if (result == 0 && data && *data && dataLength && *dataLength > 0) {
-        std::lock_guard<std::mutex> lock(g_mutex);
-        if (g_injectedFrame && g_injectedFrameSize > 0) {
-            // Copy our frame data into the camera buffer
-            int copySize = (*dataLength < g_injectedFrameSize) ? 
-                           *dataLength : g_injectedFrameSize;
-            memcpy(*data, g_injectedFrame, copySize);
-            LOGD("Injected %d bytes into plane %d", copySize, planeIdx);
+        const FrameData* prepared = g_imageFrames.claimPlane(image, planeIdx);
+        if (prepared) {
+            PipelineStats::ScopedTimer timer(PipelineStats::STAGE_INJECT);
+            
+            const AImage* target = static_cast<const AImage*>(image);
+            int32_t rowStride = 0;
+            int32_t pixelStride = 0;
+            FramePlane plane = {*data, 0, 0, static_cast<size_t>(*dataLength)};
+            if (AImage_getPlaneRowStride(target, planeIdx, &rowStride) != AMEDIA_OK ||
+                AImage_getPlanePixelStride(target, planeIdx, &pixelStride) != AMEDIA_OK) {
+                rowStride = 0;
+            }
+            plane.rowStride = rowStride;
+            plane.pixelStride = pixelStride;
+            
+            if (FrameUtils::writePlane(*prepared, planeIdx, plane)) {
+                LOGD("Injected plane %d (row stride %d, pixel stride %d)",
+                     planeIdx, rowStride, pixelStride);
+            } else {
+                timer.discard();
+                PipelineStats::recordDrop(PipelineStats::DROP_INJECT);
+            }
         }
     }
     
     return result;
 }
 
+// Hook into AImage_delete to free the image's prepared frame
+typedef void (*AImage_delete_t)(void* image);
+static AImage_delete_t original_AImage_delete = nullptr;
+
+void hooked_AImage_delete(void* image) {
+    g_imageFrames.remove(image);
+    
+    if (original_AImage_delete) {
+        original_AImage_delete(image);
+    }
+}
+
 // JNI-based hooks for Java camera API
 static jclass g_cameraDeviceClass = nullptr;
 static jclass g_cameraCaptureSessionClass = nullptr;
@@ -223,6 +700,9 @@ bool hookNativeApi() {
     original_ACameraOutputTarget_create = (ACameraOutputTarget_create_t)
         dlsym(libcamera, "ACameraOutputTarget_create");
     
+    original_ACameraOutputTarget_free = (ACameraOutputTarget_free_t)
+        dlsym(libcamera, "ACameraOutputTarget_free");
+    
     original_ACameraCaptureSession_capture = (ACameraCaptureSession_capture_t)
         dlsym(libcamera, "ACameraCaptureSession_capture");
     
@@ -239,6 +719,15 @@ bool hookNativeApi() {
         original_AImage_getPlaneData = (AImage_getPlaneData_t)
             dlsym(libmediandk, "AImage_getPlaneData");
         
+        original_AImage_delete = (AImage_delete_t)
+            dlsym(libmediandk, "AImage_delete");
+        
+        original_AImageReader_getWindow = (AImageReader_getWindow_t)
+            dlsym(libmediandk, "AImageReader_getWindow");
+        
+        original_AImageReader_delete = (AImageReader_delete_t)
+            dlsym(libmediandk, "AImageReader_delete");
+        
         LOGD("libmediandk.so hooks prepared");
     }
     
@@ -246,6 +735,140 @@ bool hookNativeApi() {
     return true;
 }
 
+// Open a video for the hooks, starting from `startUs` if that is past the
+// beginning. With `warmUp`, wait for its decoder to get ahead first; only
+// for replacements opened off the app's threads and without g_mutex, so
+// the current source keeps playing meanwhile.
+static MediaReader* openVideoReader(const std::string& path, bool warmUp, int64_t startUs) {
+    MediaReader* reader = new MediaReader();
+    if (Config::useHardwareBuffers()) {
+        reader->setOutputMode(MediaReader::OUTPUT_HARDWARE_BUFFER);
+    }
+    reader->setFrameCacheEnabled(Config::useFrameCache());
+    if (!reader->open(path)) {
+        delete reader;
+        return nullptr;
+    }
+    
+    bool seeking = startUs > 0 && reader->seek(startUs, MediaReader::SEEK_EXACT);
+    for (int waited = 0;
+         warmUp && (reader->getQueuedFrames() == 0 ||
+                    (seeking && reader->getLastSeekLatencyUs() < 0)) &&
+         waited < VIDEO_WARMUP_MS;
+         waited += 5) {
+        usleep(5000);
+    }
+    return reader;
+}
+
+static std::shared_ptr<MediaReader> openPhotoReader(const std::string& path) {
+    std::shared_ptr<MediaReader> reader = std::make_shared<MediaReader>();
+    if (!reader->open(path)) {
+        return nullptr;
+    }
+    return reader;
+}
+
+// Put `reader` (may be nullptr) and its renditions in place of the video
+// source, and have the renditions registered outputs use reopened. The
+// hooks take frames under g_mutex, so the swap lands between two frames.
+// The previous readers are deleted outside the lock.
+static void swapVideoSource(MediaReader* reader, std::vector<VideoRendition> renditions) {
+    MediaReader* previous;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        previous = g_videoReader;
+        g_videoReader = reader;
+        g_renditions.swap(renditions);
+        g_status.videoSourceReady = reader != nullptr;
+        g_status.renditionCount = static_cast<int>(g_renditions.size());
+        if (reader) {
+            g_status.frameWidth = reader->getWidth();
+            g_status.frameHeight = reader->getHeight();
+        }
+        if (reader) {
+            for (const OutputPlan& plan : g_outputPlans) {
+                requestRendition(plan.width, plan.height);
+            }
+        }
+    }
+    
+    // Renditions share the previous reader's clock; they go first
+    for (const VideoRendition& rendition : renditions) {
+        delete rendition.reader;
+    }
+    delete previous;
+}
+
+// The previous reader goes with the returned reference, outside the lock,
+// unless an acquire hook still converts from it
+static std::shared_ptr<MediaReader> swapPhotoReader(std::shared_ptr<MediaReader> reader) {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::shared_ptr<MediaReader> previous = g_photoReader;
+    g_photoReader = reader;
+    g_status.photoSourceReady = reader != nullptr;
+    return previous;
+}
+
+// Does a changed file's name refer to `path`?
+static bool isFileName(const std::string& name, const char* path) {
+    const char* slash = strrchr(path, '/');
+    return name == (slash ? slash + 1 : path);
+}
+
+// MediaWatcher callback: reload whatever the changed file feeds
+static void onMediaChanged(const std::string& name) {
+    Config::refresh();
+    
+    std::string appName;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (!g_initialized) {
+            return;
+        }
+        appName = g_appName;
+    }
+    
+    // Toggling the private directory can move both sources; so can the
+    // directory itself appearing
+    bool paths = isFileName(name, Config::PRIVATE_DIR_FILE) || name == appName;
+    if (paths) {
+        std::string privateDir = Config::getPrivateDir(appName);
+        if (!Config::usePrivateDir()) {
+            g_mediaWatcher.unwatch(privateDir);
+        } else if (!g_mediaWatcher.watch(privateDir)) {
+            LOGI("Private directory not watched yet: %s", privateDir.c_str());
+        }
+    }
+    
+    if (paths || isFileName(name, Config::VIDEO_FILE) ||
+        Config::isVideoRendition(name, Config::VIDEO_FILE)) {
+        std::string path = Config::getVideoPath(appName);
+        std::vector<VideoRendition> renditions = findRenditions(path);
+        bool exists = Config::fileExists(path.c_str());
+        MediaReader* reader = exists ? openVideoReader(path, true) : nullptr;
+        if (exists && !reader) {
+            LOGE("Reload failed, keeping current video source: %s", path.c_str());
+        } else {
+            LOGI("Video source %s: %s (%zu smaller renditions)",
+                 reader ? "reloaded" : "removed", path.c_str(), renditions.size());
+            swapVideoSource(reader, renditions);
+        }
+    }
+    
+    if (paths || isFileName(name, Config::PHOTO_FILE)) {
+        std::string path = Config::getPhotoPath(appName);
+        bool exists = Config::fileExists(path.c_str());
+        std::shared_ptr<MediaReader> reader = exists ? openPhotoReader(path) : nullptr;
+        if (exists && !reader) {
+            LOGE("Reload failed, keeping current photo source: %s", path.c_str());
+        } else {
+            swapPhotoReader(reader);
+            LOGI("Photo source %s: %s", reader ? "reloaded" : "removed", path.c_str());
+        }
+    }
+}
+
 bool initialize(JNIEnv* env, const std::string& appName) {
     std::lock_guard<std::mutex> lock(g_mutex);
     
@@ -255,19 +878,33 @@ bool initialize(JNIEnv* env, const std::string& appName) {
     }
     
     g_appName = appName;
+    // Start from the control files as they are now, not the snapshot
+    // inherited from zygote
+    Config::refresh();
     LOGI("Initializing camera hooks for %s", appName.c_str());
     
+    if (Config::statsEnabled()) {
+        PipelineStats::setEnabled(true);
+        LOGI("Pipeline stats enabled");
+    }
+    
     // Initialize media readers
     std::string videoPath = Config::getVideoPath(appName);
     std::string photoPath = Config::getPhotoPath(appName);
     
-    LOGI("Video source: %s", videoPath.c_str());
+    // Renditions are opened as outputs that need them are registered
+    g_renditions = findRenditions(videoPath);
+    g_status.renditionCount = static_cast<int>(g_renditions.size());
+    
+    LOGI("Video source: %s (%zu smaller renditions)", videoPath.c_str(), g_renditions.size());
     LOGI("Photo source: %s", photoPath.c_str());
     
-    // Create video reader
+    // Create video reader. No warm-up: this is the app's main thread,
+    // and until the first frame is decoded the hooks pass the camera's
+    // own frames through.
     if (Config::fileExists(videoPath.c_str())) {
-        g_videoReader = new MediaReader();
-        if (g_videoReader->open(videoPath)) {
+        g_videoReader = openVideoReader(videoPath, false);
+        if (g_videoReader) {
             g_status.videoSourceReady = true;
             g_status.frameWidth = g_videoReader->getWidth();
             g_status.frameHeight = g_videoReader->getHeight();
@@ -275,8 +912,6 @@ bool initialize(JNIEnv* env, const std::string& appName) {
                  g_status.frameWidth, g_status.frameHeight);
         } else {
             LOGE("Failed to open video source");
-            delete g_videoReader;
-            g_videoReader = nullptr;
         }
     } else {
         LOGI("Video source not found: %s", videoPath.c_str());
@@ -284,14 +919,12 @@ bool initialize(JNIEnv* env, const std::string& appName) {
     
     // Create photo reader
     if (Config::fileExists(photoPath.c_str())) {
-        g_photoReader = new MediaReader();
-        if (g_photoReader->open(photoPath)) {
+        g_photoReader = openPhotoReader(photoPath);
+        if (g_photoReader) {
             g_status.photoSourceReady = true;
             LOGI("Photo source ready");
         } else {
             LOGE("Failed to open photo source");
-            delete g_photoReader;
-            g_photoReader = nullptr;
         }
     } else {
         LOGI("Photo source not found: %s", photoPath.c_str());
@@ -304,6 +937,18 @@ bool initialize(JNIEnv* env, const std::string& appName) {
     if (javaHooksOk || nativeHooksOk) {
         g_initialized = true;
         g_status.initialized = true;
+        
+        // Pick up new sources and control files as they are dropped in.
+        // The private directory's watch follows PRIVATE_DIR_FILE.
+        std::vector<std::string> dirs = {Config::MEDIA_DIR};
+        if (Config::usePrivateDir()) {
+            dirs.push_back(Config::getPrivateDir(appName));
+        }
+        if (!g_mediaWatcher.start(dirs, onMediaChanged)) {
+            LOGE("Media directory not watched, sources won't reload");
+            startConfigPoller();
+        }
+        
         LOGI("Camera hooks initialized successfully");
         return true;
     }
@@ -313,23 +958,38 @@ bool initialize(JNIEnv* env, const std::string& appName) {
 }
 
 void cleanup() {
-    std::lock_guard<std::mutex> lock(g_mutex);
+    // Before taking the lock: the watcher's callback takes it too
+    g_mediaWatcher.stop();
+    stopConfigPoller();
+    
+    std::unique_lock<std::mutex> lock(g_mutex);
+    
+    // Let a rendition being opened finish; nothing else starts after it
+    g_renditionRequests.clear();
+    g_renditionWorkerIdle.wait(lock, [] { return !g_renditionWorkerBusy; });
+    
+    // Renditions share the video reader's clock; they go first
+    for (const VideoRendition& rendition : g_renditions) {
+        delete rendition.reader;
+    }
+    g_renditions.clear();
     
     if (g_videoReader) {
         delete g_videoReader;
         g_videoReader = nullptr;
     }
     
-    if (g_photoReader) {
-        delete g_photoReader;
-        g_photoReader = nullptr;
-    }
+    g_photoReader.reset();
     
-    if (g_injectedFrame) {
-        delete[] g_injectedFrame;
-        g_injectedFrame = nullptr;
-        g_injectedFrameSize = 0;
-    }
+    g_imageFrames.clear();
+    g_outputPlans.clear();
+    g_readerWindows.clear();
+    
+    // Hand cached frame buffers back to the system
+    FramePool::purge();
+    
+    PipelineStats::setEnabled(false);
+    PipelineStats::reset();
     
     g_initialized = false;
     g_status = {};
@@ -342,48 +1002,55 @@ bool isActive() {
 }
 
 bool setVideoSource(const std::string& path) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
-    if (g_videoReader) {
-        delete g_videoReader;
-    }
+    // Opened and warmed up before the swap, so the hooks keep serving the
+    // old source meanwhile
+    std::string videoPath = path;
+    std::vector<VideoRendition> renditions = findRenditions(videoPath);
+    MediaReader* reader = openVideoReader(videoPath, true);
+    swapVideoSource(reader, renditions);
     
-    g_videoReader = new MediaReader();
-    if (g_videoReader->open(path)) {
-        g_status.videoSourceReady = true;
-        LOGI("Video source set: %s", path.c_str());
+    if (reader) {
+        LOGI("Video source set: %s", videoPath.c_str());
         return true;
     }
-    
-    delete g_videoReader;
-    g_videoReader = nullptr;
-    g_status.videoSourceReady = false;
     return false;
 }
 
 bool setPhotoSource(const std::string& path) {
-    std::lock_guard<std::mutex> lock(g_mutex);
-    
-    if (g_photoReader) {
-        delete g_photoReader;
-    }
+    std::shared_ptr<MediaReader> reader = openPhotoReader(path);
+    swapPhotoReader(reader);
     
-    g_photoReader = new MediaReader();
-    if (g_photoReader->open(path)) {
-        g_status.photoSourceReady = true;
+    if (reader) {
         LOGI("Photo source set: %s", path.c_str());
         return true;
     }
-    
-    delete g_photoReader;
-    g_photoReader = nullptr;
-    g_status.photoSourceReady = false;
     return false;
 }
 
 HookStatus getStatus() {
     std::lock_guard<std::mutex> lock(g_mutex);
-    return g_status;
+    HookStatus status = g_status;
+    status.seekLatencyUs = -1;
+    
+    status.statsEnabled = PipelineStats::isEnabled();
+    for (int i = 0; i < PipelineStats::STAGE_COUNT; i++) {
+        status.stages[i] = PipelineStats::getSummary(static_cast<PipelineStats::Stage>(i));
+    }
+    for (int i = 0; i < PipelineStats::DROP_COUNT; i++) {
+        status.drops[i] = PipelineStats::getDrops(static_cast<PipelineStats::Drop>(i));
+    }
+    
+    if (g_videoReader) {
+        status.queueDepth = g_videoReader->getQueuedFrames();
+        status.queueCapacity = g_videoReader->getDecodeAheadDepth();
+        status.seekLatencyUs = g_videoReader->getLastSeekLatencyUs();
+    }
+    for (const VideoRendition& rendition : g_renditions) {
+        if (rendition.reader) {
+            status.openRenditionCount++;
+        }
+    }
+    return status;
 }
 
 } // namespace CameraHook
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include "pipeline_stats.hpp"
 #include <jni.h>
 #include <string>
 
@@ -37,6 +38,17 @@ struct HookStatus {
     int frameWidth;
     int frameHeight;
     int frameCount;
+    int renditionCount;      // Smaller renditions found next to the video
+    int openRenditionCount;  // Those currently decoding for an output
+    
+    // Pipeline timings, filled while PipelineStats is enabled
+    // (see Config::STATS_FILE)
+    bool statsEnabled;
+    PipelineStats::StageSummary stages[PipelineStats::STAGE_COUNT];
+    uint64_t drops[PipelineStats::DROP_COUNT];
+    int queueDepth;     // Decoded video frames waiting to be injected
+    int queueCapacity;  // Decode-ahead depth
+    int64_t seekLatencyUs;  // Last video seek until its frame was ready, -1 if none
 };
 
 HookStatus getStatus();
@@ -3,12 +3,23 @@
  * 
  * Handles configuration settings loaded from control files.
  * 
+ * The control files live on /sdcard, where every stat() is a FUSE round
+ * trip, so their presence is cached in a snapshot that hot paths (every
+ * log line in the hooks) read with one atomic load. Readers never stat
+ * the files: refresh() publishes a new snapshot, called when the media
+ * directory reports a change, or every REFRESH_INTERVAL_MS where it
+ * can't be watched.
+ * 
  * For educational and research purposes only.
  */
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <dirent.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -21,6 +32,31 @@ static constexpr const char* PHOTO_FILE = "/sdcard/DCIM/Camera1/1000.bmp";
 static constexpr const char* DISABLE_FILE = "/sdcard/DCIM/Camera1/disable.jpg";
 static constexpr const char* NO_TOAST_FILE = "/sdcard/DCIM/Camera1/no_toast.jpg";
 static constexpr const char* PRIVATE_DIR_FILE = "/sdcard/DCIM/Camera1/private_dir.jpg";
+static constexpr const char* STATS_FILE = "/sdcard/DCIM/Camera1/stats.jpg";
+static constexpr const char* HW_BUFFER_FILE = "/sdcard/DCIM/Camera1/hw_buffer.jpg";
+static constexpr const char* FRAME_CACHE_FILE = "/sdcard/DCIM/Camera1/frame_cache.jpg";
+
+// Decoded video loops kept by the frame cache. The module directory isn't
+// writable from app processes, so the cache lives next to the media.
+static constexpr const char* CACHE_DIR = "/sdcard/DCIM/Camera1/.framecache";
+static constexpr uint64_t FRAME_CACHE_BUDGET_BYTES = 1024ull * 1024 * 1024;
+
+// Decoded video frames kept ready ahead of the camera hooks
+static constexpr int DECODE_AHEAD_FRAMES = 4;
+
+// How often the control files are re-read when the media directory can't
+// be watched
+static constexpr int REFRESH_INTERVAL_MS = 1000;
+
+// Control files present in a snapshot
+enum Flag : uint32_t {
+    FLAG_DISABLED = 1u << 0,      // DISABLE_FILE
+    FLAG_NO_TOAST = 1u << 1,      // NO_TOAST_FILE
+    FLAG_PRIVATE_DIR = 1u << 2,   // PRIVATE_DIR_FILE
+    FLAG_STATS = 1u << 3,         // STATS_FILE
+    FLAG_HW_BUFFER = 1u << 4,     // HW_BUFFER_FILE
+    FLAG_FRAME_CACHE = 1u << 5,   // FRAME_CACHE_FILE
+};
 
 // Check if a file exists
 inline bool fileExists(const char* path) {
@@ -28,25 +64,71 @@ inline bool fileExists(const char* path) {
     return stat(path, &st) == 0;
 }
 
+namespace detail {
+inline std::atomic<uint32_t> g_flags{0};
+}
+
+// Check every control file now and publish a new snapshot (e.g. when the
+// media directory reports a change). Returns the new flags.
+inline uint32_t refresh() {
+    uint32_t flags = 0;
+    if (fileExists(DISABLE_FILE)) flags |= FLAG_DISABLED;
+    if (fileExists(NO_TOAST_FILE)) flags |= FLAG_NO_TOAST;
+    if (fileExists(PRIVATE_DIR_FILE)) flags |= FLAG_PRIVATE_DIR;
+    if (fileExists(STATS_FILE)) flags |= FLAG_STATS;
+    if (fileExists(HW_BUFFER_FILE)) flags |= FLAG_HW_BUFFER;
+    if (fileExists(FRAME_CACHE_FILE)) flags |= FLAG_FRAME_CACHE;
+    
+    detail::g_flags.store(flags, std::memory_order_release);
+    return flags;
+}
+
+// Current snapshot (no control file present until the first refresh())
+inline uint32_t flags() {
+    return detail::g_flags.load(std::memory_order_acquire);
+}
+
 // Check if module is disabled
 inline bool isDisabled() {
-    return fileExists(DISABLE_FILE);
+    return (flags() & FLAG_DISABLED) != 0;
 }
 
 // Check if toasts/logs should be suppressed
 inline bool shouldSuppressLogs() {
-    return fileExists(NO_TOAST_FILE);
+    return (flags() & FLAG_NO_TOAST) != 0;
 }
 
 // Check if app-specific directories should be used
 inline bool usePrivateDir() {
-    return fileExists(PRIVATE_DIR_FILE);
+    return (flags() & FLAG_PRIVATE_DIR) != 0;
+}
+
+// Check if per-stage pipeline timings should be recorded
+inline bool statsEnabled() {
+    return (flags() & FLAG_STATS) != 0;
+}
+
+// Check if video should be decoded into hardware buffers instead of
+// CPU memory
+inline bool useHardwareBuffers() {
+    return (flags() & FLAG_HW_BUFFER) != 0;
+}
+
+// Check if decoded video loops should be cached on disk and replayed
+// from there instead of decoding again
+inline bool useFrameCache() {
+    return (flags() & FLAG_FRAME_CACHE) != 0;
+}
+
+// An app's own media directory, used while PRIVATE_DIR_FILE is present
+inline std::string getPrivateDir(const std::string& appName) {
+    return std::string(MEDIA_DIR) + "/" + appName;
 }
 
 // Get media directory for an app
 inline std::string getMediaDir(const std::string& appName) {
     if (usePrivateDir()) {
-        return std::string(MEDIA_DIR) + "/" + appName;
+        return getPrivateDir(appName);
     }
     return MEDIA_DIR;
 }
@@ -62,6 +144,48 @@ inline std::string getVideoPath(const std::string& appName = "") {
     return VIDEO_FILE;
 }
 
+// Is `name` (no directory) a rendition of `videoPath` at another size,
+// i.e. <stem>_<digits><ext> as in virtual_720.mp4?
+inline bool isVideoRendition(const std::string& name, const std::string& videoPath) {
+    size_t slash = videoPath.rfind('/');
+    std::string base = videoPath.substr(slash == std::string::npos ? 0 : slash + 1);
+    size_t dot = base.rfind('.');
+    if (dot == std::string::npos) {
+        return false;
+    }
+    std::string stem = base.substr(0, dot) + "_";
+    std::string ext = base.substr(dot);
+    if (name.size() <= stem.size() + ext.size() ||
+        name.compare(0, stem.size(), stem) != 0 ||
+        name.compare(name.size() - ext.size(), ext.size(), ext) != 0) {
+        return false;
+    }
+    for (size_t i = stem.size(); i < name.size() - ext.size(); i++) {
+        if (name[i] < '0' || name[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Paths of the renditions of `videoPath` in its directory (any order)
+inline std::vector<std::string> getVideoRenditions(const std::string& videoPath) {
+    std::vector<std::string> renditions;
+    size_t slash = videoPath.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : videoPath.substr(0, slash);
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) {
+        return renditions;
+    }
+    while (dirent* entry = readdir(handle)) {
+        if (isVideoRendition(entry->d_name, videoPath)) {
+            renditions.push_back(dir + "/" + entry->d_name);
+        }
+    }
+    closedir(handle);
+    return renditions;
+}
+
 // Get photo file path
 inline std::string getPhotoPath(const std::string& appName = "") {
     if (usePrivateDir() && !appName.empty()) {
@@ -0,0 +1,178 @@
+/*
+ * DroidFakeCam - Frame Buffer Implementation
+ *
+ * The reference count lives at the front of the FramePool block holding
+ * the pixels, so creating and recycling a FrameBuffer costs one pool
+ * round trip and no other allocation.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_buffer.hpp"
+#include <new>
+
+namespace {
+
+// Pixels start after the header, padded to a cache line
+constexpr size_t kHeaderSize = (sizeof(FrameBuffer) + 63) & ~size_t(63);
+
+} // namespace
+
+FrameBuffer::FrameBuffer(size_t capacity, size_t blockSize)
+    : m_refs(1)
+    , m_capacity(capacity)
+    , m_blockSize(blockSize)
+    , m_data(reinterpret_cast<uint8_t*>(this) + kHeaderSize)
+    , m_hardware(nullptr)
+    , m_onRelease(nullptr)
+    , m_releaseContext(nullptr)
+{
+}
+
+FrameBuffer* FrameBuffer::acquire(size_t size) {
+    size_t blockSize = 0;
+    uint8_t* block = FramePool::acquire(kHeaderSize + size, &blockSize);
+    return new (block) FrameBuffer(blockSize - kHeaderSize, blockSize);
+}
+
+FrameBuffer* FrameBuffer::wrap(HardwareBuffer* hardware) {
+    size_t blockSize = 0;
+    uint8_t* block = FramePool::acquire(kHeaderSize, &blockSize);
+    FrameBuffer* buffer = new (block) FrameBuffer(0, blockSize);
+    buffer->m_data = nullptr;
+    buffer->m_hardware = hardware;
+    hardware->addRef();
+    return buffer;
+}
+
+FrameBuffer* FrameBuffer::wrap(uint8_t* data, void (*onRelease)(void*), void* context) {
+    size_t blockSize = 0;
+    uint8_t* block = FramePool::acquire(kHeaderSize, &blockSize);
+    FrameBuffer* buffer = new (block) FrameBuffer(0, blockSize);
+    buffer->m_data = data;
+    buffer->m_onRelease = onRelease;
+    buffer->m_releaseContext = context;
+    return buffer;
+}
+
+void FrameBuffer::addRef() {
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameBuffer::release() {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    if (m_hardware) {
+        m_hardware->release();
+    }
+    if (m_onRelease) {
+        m_onRelease(m_releaseContext);
+    }
+    size_t blockSize = m_blockSize;
+    this->~FrameBuffer();
+    FramePool::release(reinterpret_cast<uint8_t*>(this), blockSize);
+}
+
+FrameRef::FrameRef(const FrameRef& other)
+    : size(other.size)
+    , width(other.width)
+    , height(other.height)
+    , format(other.format)
+    , stride(other.stride)
+    , sliceHeight(other.sliceHeight)
+    , cropLeft(other.cropLeft)
+    , cropTop(other.cropTop)
+    , timestamp(other.timestamp)
+    , m_buffer(other.m_buffer)
+{
+    if (m_buffer) {
+        m_buffer->addRef();
+    }
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other) {
+    if (this != &other) {
+        reset(other.m_buffer);
+        size = other.size;
+        width = other.width;
+        height = other.height;
+        format = other.format;
+        stride = other.stride;
+        sliceHeight = other.sliceHeight;
+        cropLeft = other.cropLeft;
+        cropTop = other.cropTop;
+        timestamp = other.timestamp;
+    }
+    return *this;
+}
+
+FrameRef::FrameRef(FrameRef&& other) noexcept
+    : size(other.size)
+    , width(other.width)
+    , height(other.height)
+    , format(other.format)
+    , stride(other.stride)
+    , sliceHeight(other.sliceHeight)
+    , cropLeft(other.cropLeft)
+    , cropTop(other.cropTop)
+    , timestamp(other.timestamp)
+    , m_buffer(other.m_buffer)
+{
+    other.m_buffer = nullptr;
+    other.size = 0;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) noexcept {
+    if (this != &other) {
+        reset();
+        size = other.size;
+        width = other.width;
+        height = other.height;
+        format = other.format;
+        stride = other.stride;
+        sliceHeight = other.sliceHeight;
+        cropLeft = other.cropLeft;
+        cropTop = other.cropTop;
+        timestamp = other.timestamp;
+        m_buffer = other.m_buffer;
+        other.m_buffer = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+void FrameRef::reset(FrameBuffer* buffer) {
+    // Take the new reference first in case buffer == m_buffer
+    if (buffer) {
+        buffer->addRef();
+    }
+    if (m_buffer) {
+        m_buffer->release();
+    }
+    m_buffer = buffer;
+}
+
+void FrameRef::reset() {
+    if (m_buffer) {
+        m_buffer->release();
+        m_buffer = nullptr;
+    }
+    size = 0;
+}
+
+void FrameRef::view(FrameData& frame) const {
+    frame.release();
+    frame.data = m_buffer ? m_buffer->data() : nullptr;
+    frame.ownsData = false;
+    frame.size = size;
+    frame.width = width;
+    frame.height = height;
+    frame.format = format;
+    frame.stride = stride;
+    frame.sliceHeight = sliceHeight;
+    frame.cropLeft = cropLeft;
+    frame.cropTop = cropTop;
+    frame.timestamp = timestamp;
+}
@@ -0,0 +1,108 @@
+/*
+ * DroidFakeCam - Frame Buffer Header
+ *
+ * Reference-counted, pooled pixel storage and read-only frame views.
+ * Decoded video frames and loaded photos live in FrameBuffers so they can
+ * be handed to the camera hooks without copying.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_pool.hpp"
+#include "frame_utils.hpp"
+#include "hardware_buffer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class FrameBuffer {
+public:
+    // Get a buffer holding at least `size` bytes with a reference count of 1.
+    // Storage comes from FramePool.
+    static FrameBuffer* acquire(size_t size);
+
+    // Share a hardware buffer without mapping it: data() is nullptr and
+    // capacity() 0. Takes its own reference to `hardware`.
+    static FrameBuffer* wrap(HardwareBuffer* hardware);
+
+    // Share read-only memory owned by someone else (e.g. a mapped file):
+    // data() points at it and capacity() is 0, so it is never written.
+    // `onRelease(context)` runs when the last reference goes away.
+    static FrameBuffer* wrap(uint8_t* data, void (*onRelease)(void*), void* context);
+
+    void addRef();
+
+    // Drop a reference; the last one returns the buffer to the pool
+    void release();
+
+    // True if anyone besides the caller holds a reference
+    bool isShared() const { return m_refs.load(std::memory_order_acquire) > 1; }
+
+    uint8_t* data() { return m_data; }
+    const uint8_t* data() const { return m_data; }
+    size_t capacity() const { return m_capacity; }
+    HardwareBuffer* hardwareBuffer() const { return m_hardware; }
+
+private:
+    FrameBuffer(size_t capacity, size_t blockSize);
+    ~FrameBuffer() = default;
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    std::atomic<int32_t> m_refs;
+    size_t m_capacity;
+    size_t m_blockSize;  // FramePool block holding this header and the pixels
+    uint8_t* m_data;
+    HardwareBuffer* m_hardware;
+    void (*m_onRelease)(void*);  // Owner of wrapped memory
+    void* m_releaseContext;
+};
+
+// Read-only view of a frame stored in a FrameBuffer. Copying a FrameRef
+// shares the pixels; the buffer is recycled when the last view goes away.
+struct FrameRef {
+    size_t size;
+    int width;
+    int height;
+    FrameFormat format;
+    int stride;
+    int sliceHeight;  // Layout fields as in FrameData
+    int cropLeft;
+    int cropTop;
+    int64_t timestamp;
+
+    FrameRef() : size(0), width(0), height(0), format(FORMAT_NV21), stride(0),
+                 sliceHeight(0), cropLeft(0), cropTop(0), timestamp(0),
+                 m_buffer(nullptr) {}
+    ~FrameRef() { reset(); }
+
+    FrameRef(const FrameRef& other);
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef(FrameRef&& other) noexcept;
+    FrameRef& operator=(FrameRef&& other) noexcept;
+
+    // Point at `buffer`, taking an additional reference to it
+    void reset(FrameBuffer* buffer);
+
+    // Drop the view
+    void reset();
+
+    bool isValid() const { return m_buffer != nullptr; }
+    const uint8_t* data() const { return m_buffer ? m_buffer->data() : nullptr; }
+
+    // Handle for frames decoded straight into graphics memory (data() is
+    // nullptr then); lock it for CPU access
+    HardwareBuffer* hardwareBuffer() const {
+        return m_buffer ? m_buffer->hardwareBuffer() : nullptr;
+    }
+
+    // Fill a non-owning FrameData pointing at these pixels, for use with
+    // FrameUtils. Only valid while this FrameRef is alive.
+    void view(FrameData& frame) const;
+
+private:
+    FrameBuffer* m_buffer;
+};
@@ -0,0 +1,415 @@
+/*
+ * DroidFakeCam - Frame Cache Implementation
+ *
+ * File layout: a page-sized header, then one fixed-size record per frame,
+ * each a 64-byte prefix holding the timestamp followed by the pixels. The
+ * header is written last with the frame count, and the file only gets
+ * its final name after that, so a file with the final name is complete.
+ * The modification time of a cache file is its last use, for eviction.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_cache.hpp"
+#include <android/log.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+namespace {
+
+constexpr char kMagic[8] = {'D', 'F', 'C', 'A', 'C', 'H', 'E', '1'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 4096;
+constexpr size_t kRecordPrefix = 64;  // Keeps the pixels cache-line aligned
+constexpr const char* kSuffix = ".dfc";
+constexpr const char* kTmpSuffix = ".tmp";
+
+// Temporary files this old belong to a writer that died
+constexpr int64_t kStaleTmpSeconds = 3600;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t complete;
+    uint64_t keyHash;
+    int64_t mtimeNs;
+    int64_t fileSize;
+    int32_t width;
+    int32_t height;
+    int32_t format;
+    int32_t frameCount;
+    uint64_t frameSize;
+    uint64_t recordSize;
+};
+static_assert(sizeof(FileHeader) <= kHeaderSize, "header must fit its page");
+
+uint64_t hashKey(const FrameCache::Key& key) {
+    // FNV-1a over the path and file version
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+    };
+    mix(key.path.data(), key.path.size());
+    mix(&key.mtimeNs, sizeof(key.mtimeNs));
+    mix(&key.fileSize, sizeof(key.fileSize));
+    return hash;
+}
+
+bool endsWith(const std::string& name, const char* suffix) {
+    size_t length = strlen(suffix);
+    return name.size() > length && name.compare(name.size() - length, length, suffix) == 0;
+}
+
+bool writeAll(int fd, const void* data, size_t size, uint64_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+namespace FrameCache {
+
+std::string fileName(const Key& key) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx%s",
+             static_cast<unsigned long long>(hashKey(key)), kSuffix);
+    return name;
+}
+
+void evict(const std::string& dir, uint64_t budgetBytes, const std::string& keep) {
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) {
+        return;
+    }
+
+    struct CacheEntry {
+        std::string path;
+        uint64_t bytes;
+        int64_t usedNs;
+    };
+    std::vector<CacheEntry> entries;
+    uint64_t total = 0;
+    time_t now = time(nullptr);
+
+    while (dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+
+        if (endsWith(name, kTmpSuffix)) {
+            if (now - st.st_mtim.tv_sec > kStaleTmpSeconds) {
+                unlink(path.c_str());
+            }
+            continue;
+        }
+        if (!endsWith(name, kSuffix)) {
+            continue;
+        }
+
+        total += static_cast<uint64_t>(st.st_size);
+        if (name != keep) {
+            entries.push_back({path, static_cast<uint64_t>(st.st_size),
+                               static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                               st.st_mtim.tv_nsec});
+        }
+    }
+    closedir(handle);
+
+    std::sort(entries.begin(), entries.end(),
+              [](const CacheEntry& a, const CacheEntry& b) { return a.usedNs < b.usedNs; });
+    for (const CacheEntry& entry : entries) {
+        if (total <= budgetBytes) {
+            break;
+        }
+        // Readers that still map it keep their pages until they unmap
+        if (unlink(entry.path.c_str()) == 0) {
+            total -= entry.bytes;
+            LOGD("Frame cache: evicted %s", entry.path.c_str());
+        }
+    }
+}
+
+} // namespace FrameCache
+
+FrameCacheFile::FrameCacheFile(uint8_t* mapping, size_t mappingSize)
+    : m_refs(1)
+    , m_mapping(mapping)
+    , m_mappingSize(mappingSize)
+    , m_frameCount(0)
+    , m_width(0)
+    , m_height(0)
+    , m_format(FORMAT_YUV420)
+    , m_frameSize(0)
+    , m_recordSize(0)
+{
+    FileHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    m_frameCount = header.frameCount;
+    m_width = header.width;
+    m_height = header.height;
+    m_format = static_cast<FrameFormat>(header.format);
+    m_frameSize = static_cast<size_t>(header.frameSize);
+    m_recordSize = static_cast<size_t>(header.recordSize);
+}
+
+FrameCacheFile::~FrameCacheFile() {
+    munmap(m_mapping, m_mappingSize);
+}
+
+FrameCacheFile* FrameCacheFile::open(const std::string& dir, const FrameCache::Key& key) {
+    std::string path = dir + "/" + FrameCache::fileName(key);
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    FileHeader header;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kHeaderSize ||
+        pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    // The name is only a hash; the header has to agree on the source too
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    FrameUtils::PlaneLayout layout;
+    bool valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header.version == kVersion && header.complete == 1 &&
+                 header.keyHash == hashKey(key) && header.mtimeNs == key.mtimeNs &&
+                 header.fileSize == key.fileSize && header.frameCount > 0 &&
+                 FrameUtils::getPlaneLayout(static_cast<FrameFormat>(header.format),
+                                            header.width, header.height, 0, layout) &&
+                 header.frameSize == FrameUtils::getLayoutSize(layout) &&
+                 header.recordSize >= kRecordPrefix + header.frameSize &&
+                 (fileSize - kHeaderSize) / header.recordSize >=
+                     static_cast<uint64_t>(header.frameCount);
+    if (!valid) {
+        LOGE("Frame cache: ignoring invalid file %s", path.c_str());
+        ::close(fd);
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    // Last use, for eviction
+    futimens(fd, nullptr);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOGE("Frame cache: cannot map %s", path.c_str());
+        return nullptr;
+    }
+    // Frames are read in order; let the kernel read ahead
+    madvise(mapping, fileSize, MADV_SEQUENTIAL);
+
+    FrameCacheFile* file = new FrameCacheFile(static_cast<uint8_t*>(mapping), fileSize);
+    LOGI("Frame cache: using %s (%d frames, %dx%d)", path.c_str(), file->m_frameCount,
+         file->m_width, file->m_height);
+    return file;
+}
+
+void FrameCacheFile::addRef() {
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameCacheFile::release() {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+
+const uint8_t* FrameCacheFile::record(int index) const {
+    return m_mapping + kHeaderSize + static_cast<size_t>(index) * m_recordSize;
+}
+
+int64_t FrameCacheFile::timestamp(int index) const {
+    int64_t timestampUs;
+    memcpy(&timestampUs, record(index), sizeof(timestampUs));
+    return timestampUs;
+}
+
+int FrameCacheFile::findFrame(int64_t timestampUs) const {
+    // Timestamps increase through the loop
+    int low = 0;
+    int high = m_frameCount;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (timestamp(mid) < timestampUs) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low < m_frameCount ? low : 0;
+}
+
+FrameBuffer* FrameCacheFile::wrapFrame(int index) {
+    addRef();
+    return FrameBuffer::wrap(const_cast<uint8_t*>(record(index)) + kRecordPrefix,
+                             [](void* file) { static_cast<FrameCacheFile*>(file)->release(); },
+                             this);
+}
+
+FrameCacheWriter::FrameCacheWriter(const std::string& dir, const std::string& name,
+                                   uint64_t keyHash, uint64_t budgetBytes)
+    : m_dir(dir)
+    , m_name(name)
+    , m_tmpPath(dir + "/" + name + "." + std::to_string(getpid()) + kTmpSuffix)
+    , m_fd(-1)
+    , m_keyHash(keyHash)
+    , m_budgetBytes(budgetBytes)
+    , m_frameCount(0)
+    , m_firstTimestamp(0)
+    , m_width(0)
+    , m_height(0)
+    , m_format(FORMAT_YUV420)
+    , m_frameSize(0)
+    , m_recordSize(0)
+    , m_bytes(kHeaderSize)
+    , m_finished(false)
+{
+}
+
+FrameCacheWriter* FrameCacheWriter::create(const std::string& dir, const FrameCache::Key& key,
+                                           uint64_t budgetBytes) {
+    if (mkdir(dir.c_str(), 0775) != 0 && errno != EEXIST) {
+        LOGE("Frame cache: cannot create %s", dir.c_str());
+        return nullptr;
+    }
+
+    FrameCacheWriter* writer = new FrameCacheWriter(dir, FrameCache::fileName(key), hashKey(key),
+                                                     budgetBytes);
+    writer->m_fd = ::open(writer->m_tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0664);
+    if (writer->m_fd < 0) {
+        LOGE("Frame cache: cannot write %s", writer->m_tmpPath.c_str());
+        delete writer;
+        return nullptr;
+    }
+
+    // Placeholder until finish() knows the frame count
+    FileHeader header = {};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.keyHash = writer->m_keyHash;
+    header.mtimeNs = key.mtimeNs;
+    header.fileSize = key.fileSize;
+    if (!writeAll(writer->m_fd, &header, sizeof(header), 0)) {
+        delete writer;
+        return nullptr;
+    }
+    return writer;
+}
+
+FrameCacheWriter::~FrameCacheWriter() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    if (!m_finished) {
+        unlink(m_tmpPath.c_str());
+    }
+}
+
+bool FrameCacheWriter::append(const FrameData& frame, int64_t timestampUs) {
+    if (m_fd < 0 || !frame.data) {
+        return false;
+    }
+
+    if (m_frameCount == 0) {
+        FrameUtils::PlaneLayout layout;
+        if (!FrameUtils::getPlaneLayout(frame.format, frame.width, frame.height, 0, layout) ||
+            frame.size != FrameUtils::getLayoutSize(layout)) {
+            return false;
+        }
+        m_width = frame.width;
+        m_height = frame.height;
+        m_format = frame.format;
+        m_frameSize = frame.size;
+        m_recordSize = (kRecordPrefix + m_frameSize + 63) & ~size_t(63);
+        m_firstTimestamp = timestampUs;
+    } else if (frame.width != m_width || frame.height != m_height ||
+               frame.format != m_format || frame.size != m_frameSize) {
+        return false;
+    }
+
+    if (m_bytes + m_recordSize > m_budgetBytes) {
+        LOGI("Frame cache: loop doesn't fit the %llu byte budget",
+             static_cast<unsigned long long>(m_budgetBytes));
+        return false;
+    }
+
+    uint8_t prefix[kRecordPrefix] = {};
+    memcpy(prefix, &timestampUs, sizeof(timestampUs));
+    if (!writeAll(m_fd, prefix, sizeof(prefix), m_bytes) ||
+        !writeAll(m_fd, frame.data, m_frameSize, m_bytes + kRecordPrefix)) {
+        LOGE("Frame cache: write failed, abandoning %s", m_tmpPath.c_str());
+        return false;
+    }
+    m_bytes += m_recordSize;
+    m_frameCount++;
+    return true;
+}
+
+bool FrameCacheWriter::finish() {
+    if (m_fd < 0 || m_frameCount == 0) {
+        return false;
+    }
+
+    FileHeader header;
+    if (pread(m_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        return false;
+    }
+    header.complete = 1;
+    header.width = m_width;
+    header.height = m_height;
+    header.format = m_format;
+    header.frameCount = m_frameCount;
+    header.frameSize = m_frameSize;
+    header.recordSize = m_recordSize;
+
+    // The last record's padding was never written
+    bool written = ftruncate(m_fd, static_cast<off_t>(m_bytes)) == 0 &&
+                   writeAll(m_fd, &header, sizeof(header), 0);
+    ::close(m_fd);
+    m_fd = -1;
+
+    std::string path = m_dir + "/" + m_name;
+    if (!written || rename(m_tmpPath.c_str(), path.c_str()) != 0) {
+        LOGE("Frame cache: cannot complete %s", path.c_str());
+        return false;
+    }
+    m_finished = true;
+    LOGI("Frame cache: wrote %s (%d frames, %llu bytes)", path.c_str(), m_frameCount,
+         static_cast<unsigned long long>(m_bytes));
+
+    FrameCache::evict(m_dir, m_budgetBytes, m_name);
+    return true;
+}
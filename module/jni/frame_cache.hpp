@@ -0,0 +1,131 @@
+/*
+ * DroidFakeCam - Frame Cache Header
+ *
+ * On-disk cache of decoded video loops. The first time a source plays
+ * through, its frames are written converted and packed to a file; later
+ * loops and sessions map that file and hand the frames out straight from
+ * the mapping, with no decoding or conversion. Files are kept within a
+ * byte budget by evicting the least recently used.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_buffer.hpp"
+#include "frame_utils.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace FrameCache {
+
+// Version of a source file. A cache file is only used for the exact
+// version it was written from.
+struct Key {
+    std::string path;
+    int64_t mtimeNs;
+    int64_t fileSize;
+};
+
+// Name of the cache file for `key` (no directory)
+std::string fileName(const Key& key);
+
+// Delete the least recently used cache files in `dir` until the rest add
+// up to at most `budgetBytes`. The file named `keep` is never deleted.
+void evict(const std::string& dir, uint64_t budgetBytes, const std::string& keep);
+
+} // namespace FrameCache
+
+// A complete cache file, mapped read-only. Reference counted: frames
+// handed out by wrapFrame() keep the mapping alive.
+class FrameCacheFile {
+public:
+    // Map the cache file for `key`, nullptr if there is none (or it is
+    // incomplete or damaged). Marks the file as recently used.
+    static FrameCacheFile* open(const std::string& dir, const FrameCache::Key& key);
+
+    void addRef();
+    void release();
+
+    int frameCount() const { return m_frameCount; }
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    FrameFormat format() const { return m_format; }
+    size_t frameSize() const { return m_frameSize; }
+
+    int64_t timestamp(int index) const;
+
+    // First frame at or after `timestampUs` (0 past the last frame)
+    int findFrame(int64_t timestampUs) const;
+
+    // Buffer sharing frame `index`'s pixels, with a reference for the caller
+    FrameBuffer* wrapFrame(int index);
+
+private:
+    FrameCacheFile(uint8_t* mapping, size_t mappingSize);
+    ~FrameCacheFile();
+
+    FrameCacheFile(const FrameCacheFile&) = delete;
+    FrameCacheFile& operator=(const FrameCacheFile&) = delete;
+
+    const uint8_t* record(int index) const;
+
+    std::atomic<int32_t> m_refs;
+    uint8_t* m_mapping;
+    size_t m_mappingSize;
+    int m_frameCount;
+    int m_width;
+    int m_height;
+    FrameFormat m_format;
+    size_t m_frameSize;
+    size_t m_recordSize;
+};
+
+// Writes one loop of frames to a temporary file, which becomes the cache
+// file for its key once finish() succeeds.
+class FrameCacheWriter {
+public:
+    // Start a cache file for `key`; nullptr if the directory isn't
+    // writable. Files that would outgrow `budgetBytes` are abandoned.
+    static FrameCacheWriter* create(const std::string& dir, const FrameCache::Key& key,
+                                    uint64_t budgetBytes);
+
+    // Discards the file unless finish() succeeded
+    ~FrameCacheWriter();
+
+    // Append a packed frame. The first frame fixes the size and format;
+    // false if a frame doesn't match, or the file can't grow.
+    bool append(const FrameData& frame, int64_t timestampUs);
+
+    int frameCount() const { return m_frameCount; }
+    int64_t firstTimestamp() const { return m_firstTimestamp; }
+
+    // Complete the file, move it into place and trim the directory to the
+    // budget
+    bool finish();
+
+private:
+    FrameCacheWriter(const std::string& dir, const std::string& name, uint64_t keyHash,
+                     uint64_t budgetBytes);
+
+    FrameCacheWriter(const FrameCacheWriter&) = delete;
+    FrameCacheWriter& operator=(const FrameCacheWriter&) = delete;
+
+    std::string m_dir;
+    std::string m_name;     // Final file name
+    std::string m_tmpPath;  // Written here until finish()
+    int m_fd;
+    uint64_t m_keyHash;
+    uint64_t m_budgetBytes;
+    int m_frameCount;
+    int64_t m_firstTimestamp;
+    int m_width;
+    int m_height;
+    FrameFormat m_format;
+    size_t m_frameSize;
+    size_t m_recordSize;
+    uint64_t m_bytes;       // File size so far
+    bool m_finished;
+};
@@ -0,0 +1,158 @@
+/*
+ * DroidFakeCam - Frame Pool Implementation
+ *
+ * Blocks are grouped by rounded size. Each class remembers how many blocks
+ * were in use at its busiest point during the current trim window and
+ * caches at most that many, so a burst (e.g. a resolution change) is
+ * handed back to the system once it has passed.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_pool.hpp"
+#include <android/log.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+
+namespace FramePool {
+
+namespace {
+
+// Blocks up to this size round to a power of two, larger ones to a
+// multiple of it (a 1080p NV12 frame wastes < 2%)
+constexpr size_t kLargeGranularity = 64 * 1024;
+constexpr size_t kMinBlockSize = 256;
+
+// Acquisitions between automatic trims (~10 s of 30 fps processing)
+constexpr uint64_t kTrimInterval = 1024;
+
+struct SizeClass {
+    std::vector<uint8_t*> freeBlocks;
+    size_t inUse = 0;
+    size_t highWater = 0;  // Peak inUse during the current trim window
+};
+
+std::mutex g_mutex;
+std::unordered_map<size_t, SizeClass> g_classes;
+Stats g_stats = {};
+uint64_t g_acquiresSinceTrim = 0;
+
+size_t classSize(size_t size) {
+    if (size <= kLargeGranularity) {
+        size_t rounded = kMinBlockSize;
+        while (rounded < size) {
+            rounded <<= 1;
+        }
+        return rounded;
+    }
+    return (size + kLargeGranularity - 1) / kLargeGranularity * kLargeGranularity;
+}
+
+// Caller holds g_mutex
+void trimLocked(bool purgeAll) {
+    for (auto& entry : g_classes) {
+        SizeClass& sc = entry.second;
+        size_t keep = 0;
+        if (!purgeAll && sc.highWater > sc.inUse) {
+            keep = sc.highWater - sc.inUse;
+        }
+
+        while (sc.freeBlocks.size() > keep) {
+            delete[] sc.freeBlocks.back();
+            sc.freeBlocks.pop_back();
+            g_stats.cachedBytes -= entry.first;
+            g_stats.trimmed++;
+        }
+
+        // Start a new window from the current load
+        sc.highWater = sc.inUse;
+    }
+    g_acquiresSinceTrim = 0;
+}
+
+} // namespace
+
+uint8_t* acquire(size_t size, size_t* capacity) {
+    size_t rounded = classSize(size);
+    *capacity = rounded;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    if (++g_acquiresSinceTrim >= kTrimInterval) {
+        trimLocked(false);
+    }
+
+    SizeClass& sc = g_classes[rounded];
+    sc.inUse++;
+    if (sc.inUse > sc.highWater) {
+        sc.highWater = sc.inUse;
+    }
+    g_stats.outstandingBytes += rounded;
+
+    if (!sc.freeBlocks.empty()) {
+        uint8_t* block = sc.freeBlocks.back();
+        sc.freeBlocks.pop_back();
+        g_stats.cachedBytes -= rounded;
+        g_stats.hits++;
+        return block;
+    }
+
+    g_stats.misses++;
+    LOGD("FramePool: allocating %zu byte block (requested %zu)", rounded, size);
+
+    // Reserve list capacity now so releases never allocate
+    if (sc.freeBlocks.capacity() < sc.highWater) {
+        sc.freeBlocks.reserve(sc.highWater * 2);
+    }
+    return new uint8_t[rounded];
+}
+
+void release(uint8_t* block, size_t capacity) {
+    if (!block) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+
+    auto it = g_classes.find(capacity);
+    if (it == g_classes.end()) {
+        // Not one of ours; should never happen
+        delete[] block;
+        return;
+    }
+
+    SizeClass& sc = it->second;
+    sc.inUse--;
+    g_stats.outstandingBytes -= capacity;
+
+    // Never cache more than the window's peak demand
+    if (sc.inUse + sc.freeBlocks.size() >= sc.highWater) {
+        delete[] block;
+        g_stats.trimmed++;
+        return;
+    }
+
+    sc.freeBlocks.push_back(block);
+    g_stats.cachedBytes += capacity;
+}
+
+void trim() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    trimLocked(false);
+}
+
+void purge() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    trimLocked(true);
+}
+
+Stats getStats() {
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_stats;
+}
+
+} // namespace FramePool
@@ -0,0 +1,43 @@
+/*
+ * DroidFakeCam - Frame Pool Header
+ *
+ * Size-class allocator for frame-sized blocks. Every FrameData and
+ * FrameBuffer draws its pixels from here, so once a capture session has
+ * warmed up, processing frames no longer touches the heap.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FramePool {
+
+struct Stats {
+    uint64_t hits;          // Acquisitions served from the cache
+    uint64_t misses;        // Acquisitions that had to allocate
+    uint64_t trimmed;       // Cached blocks freed by trimming
+    size_t cachedBytes;     // Bytes parked in the cache
+    size_t outstandingBytes;  // Bytes currently handed out
+};
+
+// Get a block of at least `size` bytes. The usable size is stored in
+// `capacity` and must be passed back to release().
+uint8_t* acquire(size_t size, size_t* capacity);
+
+// Return a block obtained from acquire()
+void release(uint8_t* block, size_t capacity);
+
+// Free cached blocks that exceed each size class's recent high-water mark.
+// Also runs periodically on its own.
+void trim();
+
+// Free every cached block (outstanding blocks are unaffected)
+void purge();
+
+// Snapshot of the pool counters
+Stats getStats();
+
+} // namespace FramePool
@@ -0,0 +1,252 @@
+/*
+ * DroidFakeCam - Frame Ring Implementation
+ *
+ * Slots are recycled by the producer only once they are older than the
+ * newest consumed frame and no reader has them pinned, so a consumer that
+ * pins a slot and re-validates its sequence number can safely read it
+ * without taking a lock.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_ring.hpp"
+#include <chrono>
+#include <cstdint>
+
+FrameRing::FrameRing(int depth)
+    : m_depth(depth < 1 ? 1 : depth)
+    // One extra slot keeps the last consumed frame for repeats, one more
+    // gives the producer somewhere to write while the ring is otherwise full
+    , m_slots(m_depth + 2)
+    , m_produced(0)
+    , m_consumed(0)
+{
+}
+
+FrameRing::~FrameRing() {
+    for (Slot& slot : m_slots) {
+        if (slot.buffer) {
+            slot.buffer->release();
+        }
+    }
+}
+
+uint8_t* FrameRing::Slot::prepare(size_t bytes) {
+    if (buffer && (buffer->isShared() || buffer->capacity() < bytes)) {
+        buffer->release();
+        buffer = nullptr;
+    }
+    if (!buffer) {
+        buffer = FrameBuffer::acquire(bytes);
+    }
+    size = bytes;
+    return buffer->data();
+}
+
+void FrameRing::Slot::attach(HardwareBuffer* hardware) {
+    if (buffer) {
+        buffer->release();
+    }
+    buffer = FrameBuffer::wrap(hardware);
+    size = 0;
+}
+
+void FrameRing::Slot::attach(FrameBuffer* frame) {
+    frame->addRef();
+    if (buffer) {
+        buffer->release();
+    }
+    buffer = frame;
+}
+
+int FrameRing::pending() const {
+    uint64_t produced = m_produced.load(std::memory_order_acquire);
+    uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+    return produced > consumed ? static_cast<int>(produced - consumed) : 0;
+}
+
+FrameRing::Slot* FrameRing::beginWrite() {
+    if (pending() >= m_depth) {
+        return nullptr;
+    }
+
+    uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+
+    for (Slot& slot : m_slots) {
+        // Keep unconsumed frames and the last consumed one (for repeats)
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != 0 && seq >= consumed) {
+            continue;
+        }
+
+        int32_t expected = 0;
+        if (slot.pins.compare_exchange_strong(expected, -1,
+                                              std::memory_order_acquire)) {
+            slot.seq.store(0, std::memory_order_release);
+            return &slot;
+        }
+    }
+
+    // Every recyclable slot is pinned by a slow reader
+    return nullptr;
+}
+
+void FrameRing::commitWrite(Slot* slot) {
+    uint64_t seq = m_produced.load(std::memory_order_relaxed) + 1;
+    slot->seq.store(seq, std::memory_order_release);
+    slot->pins.store(0, std::memory_order_release);
+    m_produced.store(seq, std::memory_order_release);
+}
+
+void FrameRing::abortWrite(Slot* slot) {
+    slot->pins.store(0, std::memory_order_release);
+}
+
+void FrameRing::waitForSpace(int timeoutMs) {
+    // Consumers notify without holding the mutex, so a wakeup can be missed;
+    // the timeout bounds how long that can delay the producer.
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    m_spaceAvailable.wait_for(lock, std::chrono::milliseconds(timeoutMs));
+}
+
+int FrameRing::flush() {
+    uint64_t produced = m_produced.load(std::memory_order_acquire);
+    uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+
+    // Mark everything published so far as consumed; the newest stale frame
+    // keeps being repeated until the first post-flush frame arrives.
+    while (consumed < produced) {
+        if (m_consumed.compare_exchange_weak(consumed, produced,
+                                             std::memory_order_acq_rel)) {
+            return static_cast<int>(produced - consumed);
+        }
+    }
+    return 0;
+}
+
+void FrameRing::wake() {
+    m_spaceAvailable.notify_all();
+}
+
+bool FrameRing::pinSlot(Slot& slot, uint64_t seq) {
+    int32_t pins = slot.pins.load(std::memory_order_acquire);
+    while (pins >= 0) {
+        if (slot.pins.compare_exchange_weak(pins, pins + 1,
+                                            std::memory_order_acquire)) {
+            // The producer may have recycled the slot before we pinned it
+            if (slot.seq.load(std::memory_order_acquire) == seq) {
+                return true;
+            }
+            unpinSlot(slot);
+            return false;
+        }
+    }
+    return false;
+}
+
+void FrameRing::unpinSlot(Slot& slot) {
+    slot.pins.fetch_sub(1, std::memory_order_release);
+}
+
+FrameRing::Slot* FrameRing::findPinned(uint64_t seq) {
+    for (Slot& slot : m_slots) {
+        if (slot.seq.load(std::memory_order_acquire) == seq && pinSlot(slot, seq)) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+void FrameRing::read(const Slot& slot, FrameRef& frame) {
+    // The slot's own reference keeps the buffer alive while pinned
+    frame.reset(slot.buffer);
+    frame.size = slot.size;
+    frame.width = slot.width;
+    frame.height = slot.height;
+    frame.format = slot.format;
+    frame.stride = slot.stride;
+    frame.sliceHeight = slot.sliceHeight;
+    frame.cropLeft = slot.cropLeft;
+    frame.cropTop = slot.cropTop;
+    frame.timestamp = slot.timestamp;
+}
+
+bool FrameRing::pop(FrameRef& frame, bool* fresh) {
+    // Every published frame is due: the newest one is taken, and the ones
+    // passed over become free for the producer to recycle
+    int advanced = 0;
+    if (!popDue(frame, INT64_MAX, &advanced)) {
+        return false;
+    }
+    if (fresh) {
+        *fresh = advanced > 0;
+    }
+    return true;
+}
+
+bool FrameRing::popDue(FrameRef& frame, int64_t dueUs, int* advanced) {
+    for (;;) {
+        uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+        uint64_t produced = m_produced.load(std::memory_order_acquire);
+
+        // Newest published frame that is due; the ones before it are skipped
+        uint64_t want = consumed;
+        for (uint64_t seq = consumed + 1; seq <= produced; seq++) {
+            Slot* slot = findPinned(seq);
+            if (!slot) {
+                break;
+            }
+            bool due = slot->position <= dueUs;
+            unpinSlot(*slot);
+            if (!due) {
+                break;
+            }
+            want = seq;
+        }
+        if (want == 0) {
+            if (produced == 0) {
+                return false;  // Nothing decoded yet
+            }
+            want = 1;
+        }
+
+        Slot* found = findPinned(want);
+        if (!found) {
+            continue;
+        }
+
+        if (want != consumed &&
+            !m_consumed.compare_exchange_strong(consumed, want,
+                                                std::memory_order_acq_rel)) {
+            unpinSlot(*found);
+            continue;
+        }
+
+        read(*found, frame);
+        unpinSlot(*found);
+
+        if (advanced) {
+            *advanced = static_cast<int>(want - consumed);
+        }
+        if (want != consumed) {
+            m_spaceAvailable.notify_one();
+        }
+        return true;
+    }
+}
+
+bool FrameRing::nextPosition(int64_t* position) {
+    uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+    uint64_t produced = m_produced.load(std::memory_order_acquire);
+    if (produced <= consumed) {
+        return false;
+    }
+
+    Slot* slot = findPinned(consumed + 1);
+    if (!slot) {
+        return false;
+    }
+    *position = slot->position;
+    unpinSlot(*slot);
+    return true;
+}
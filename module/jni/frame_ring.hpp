@@ -0,0 +1,126 @@
+/*
+ * DroidFakeCam - Frame Ring Header
+ *
+ * Bounded ring of pre-decoded frames shared between a MediaReader's
+ * decoder thread (single producer) and the camera hook threads (consumers).
+ * Consumers never block: taking a frame costs a few atomic operations.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_buffer.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class FrameRing {
+public:
+    struct Slot {
+        FrameBuffer* buffer;
+        size_t size;
+        int width;
+        int height;
+        FrameFormat format;
+        int stride;
+        int sliceHeight;
+        int cropLeft;
+        int cropTop;
+        int64_t timestamp;
+        // Where the frame falls on the producer's playback clock (e.g. the
+        // timestamp continued across loops); used by popDue()
+        int64_t position;
+
+        // -1 while the producer owns the slot, otherwise the reader count
+        std::atomic<int32_t> pins;
+        // Publish sequence of the frame held in this slot (0 = empty)
+        std::atomic<uint64_t> seq;
+
+        Slot() : buffer(nullptr), size(0), width(0), height(0), format(FORMAT_NV21),
+                 stride(0), sliceHeight(0), cropLeft(0), cropTop(0),
+                 timestamp(0), position(0), pins(0), seq(0) {}
+
+        // Producer: writable storage for a `size`-byte frame. Reuses the
+        // slot's buffer unless a consumer still holds a FrameRef to it.
+        uint8_t* prepare(size_t size);
+
+        // Producer: hold a hardware buffer instead of CPU pixels (takes its
+        // own reference). Nothing is copied.
+        void attach(HardwareBuffer* hardware);
+
+        // Producer: hold a buffer that already has the pixels (takes its
+        // own reference). Nothing is copied.
+        void attach(FrameBuffer* frame);
+    };
+
+    // depth = maximum number of decoded-but-unconsumed frames
+    explicit FrameRing(int depth);
+    ~FrameRing();
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    int getDepth() const { return m_depth; }
+
+    // Number of decoded frames waiting to be consumed
+    int pending() const;
+
+    // Producer: claim a slot to decode into, nullptr if the ring is full
+    Slot* beginWrite();
+
+    // Producer: publish a filled slot
+    void commitWrite(Slot* slot);
+
+    // Producer: give a claimed slot back without publishing it
+    void abortWrite(Slot* slot);
+
+    // Producer: block until a consumer frees space or timeout expires
+    void waitForSpace(int timeoutMs);
+
+    // Producer: drop all unconsumed frames (e.g. after a seek). Returns
+    // how many were dropped.
+    int flush();
+
+    // Producer: wake a producer blocked in waitForSpace
+    void wake();
+
+    // Consumer: take a reference to the newest decoded frame, passing over
+    // any older ones a slow consumer didn't get to (they are freed for the
+    // producer). When no new frame is ready the last consumed frame is
+    // repeated. Never blocks and never copies pixels. `fresh` (optional) is
+    // set to false when the frame is a repeat.
+    bool pop(FrameRef& frame, bool* fresh = nullptr);
+
+    // Consumer: like pop(), but take the newest frame whose position is
+    // at or before `dueUs`, and repeat the last frame while the next
+    // isn't due. The very first frame is taken even
+    // if early. `advanced` (optional) is set to the number of frames
+    // moved past: 0 for a repeat, more than 1 when frames were skipped.
+    bool popDue(FrameRef& frame, int64_t dueUs, int* advanced = nullptr);
+
+    // Consumer: position of the oldest unconsumed frame, false if none
+    bool nextPosition(int64_t* position);
+
+private:
+    int m_depth;
+    std::vector<Slot> m_slots;
+
+    std::atomic<uint64_t> m_produced;  // seq of the newest published frame
+    std::atomic<uint64_t> m_consumed;  // seq of the newest consumed frame
+
+    // Only the producer ever waits on this
+    std::mutex m_waitMutex;
+    std::condition_variable m_spaceAvailable;
+
+    bool pinSlot(Slot& slot, uint64_t seq);
+    void unpinSlot(Slot& slot);
+
+    // Slot holding frame `seq`, pinned; nullptr if it isn't (or no longer) there
+    Slot* findPinned(uint64_t seq);
+
+    // Fill `frame` from a pinned slot
+    static void read(const Slot& slot, FrameRef& frame);
+};
@@ -0,0 +1,146 @@
+/*
+ * DroidFakeCam - Frame Scaler Implementation
+ *
+ * Each needed source row is scaled horizontally once into a small row
+ * cache (FrameSimd scaleRow); destination rows are then a vertical blend
+ * of two cached rows, which is a straight SIMD loop (FrameSimd blendRows). Sampling matches
+ * the previous float scaler (source = dst * srcSize / dstSize), with Q8
+ * weights instead of floats.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_scaler.hpp"
+#include "frame_simd.hpp"
+#include "frame_utils.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
+namespace FrameScaler {
+
+namespace {
+
+// Distinct size pairs kept around (preview + capture streams, rotations)
+constexpr size_t kMaxCachedPlans = 8;
+
+std::mutex g_planMutex;
+std::vector<std::shared_ptr<const Plan>> g_plans;  // Most recent first
+
+void buildTaps(std::vector<Tap>& taps, int srcSize, int dstSize) {
+    taps.resize(dstSize);
+    for (int i = 0; i < dstSize; i++) {
+        // Source position in Q8
+        int64_t pos = static_cast<int64_t>(i) * srcSize * 256 / dstSize;
+        Tap& tap = taps[i];
+        tap.index0 = static_cast<int32_t>(pos >> 8);
+        tap.index1 = std::min(tap.index0 + 1, srcSize - 1);
+        tap.weight = (tap.index1 == tap.index0) ? 0 : static_cast<uint16_t>(pos & 255);
+    }
+}
+
+std::shared_ptr<const Plan> buildPlan(int srcWidth, int srcHeight,
+                                      int dstWidth, int dstHeight) {
+    std::shared_ptr<Plan> plan = std::make_shared<Plan>();
+    plan->srcWidth = srcWidth;
+    plan->srcHeight = srcHeight;
+    plan->dstWidth = dstWidth;
+    plan->dstHeight = dstHeight;
+    buildTaps(plan->columns, srcWidth, dstWidth);
+    buildTaps(plan->rows, srcHeight, dstHeight);
+    plan->columnIndex.resize(dstWidth);
+    plan->columnWeight.resize(dstWidth);
+    for (int x = 0; x < dstWidth; x++) {
+        plan->columnIndex[x] = plan->columns[x].index0;
+        plan->columnWeight[x] = static_cast<uint8_t>(plan->columns[x].weight);
+    }
+    return plan;
+}
+
+} // namespace
+
+std::shared_ptr<const Plan> getPlan(int srcWidth, int srcHeight,
+                                    int dstWidth, int dstHeight) {
+    std::lock_guard<std::mutex> lock(g_planMutex);
+
+    for (size_t i = 0; i < g_plans.size(); i++) {
+        const Plan& p = *g_plans[i];
+        if (p.srcWidth == srcWidth && p.srcHeight == srcHeight &&
+            p.dstWidth == dstWidth && p.dstHeight == dstHeight) {
+            std::shared_ptr<const Plan> plan = g_plans[i];
+            g_plans.erase(g_plans.begin() + i);
+            g_plans.insert(g_plans.begin(), plan);
+            return plan;
+        }
+    }
+
+    std::shared_ptr<const Plan> plan = buildPlan(srcWidth, srcHeight,
+                                                 dstWidth, dstHeight);
+    g_plans.insert(g_plans.begin(), plan);
+    if (g_plans.size() > kMaxCachedPlans) {
+        g_plans.pop_back();
+    }
+    return plan;
+}
+
+void scalePlane(const Plan& plan, int bpp,
+                const uint8_t* src, int srcStride,
+                uint8_t* dst, int dstStride) {
+    const FrameSimd::Kernels& kernels = FrameSimd::best();
+    int rowBytes = plan.dstWidth * bpp;
+    bool sameWidth = plan.srcWidth == plan.dstWidth;
+
+    // Two horizontally scaled source rows, tagged with their source index.
+    // With equal widths the source rows are used directly.
+    FrameData scratch;
+    if (!sameWidth) {
+        scratch.allocate(static_cast<size_t>(rowBytes) * 2);
+    }
+    const uint8_t* cachedRow[2] = {nullptr, nullptr};
+    int cachedIndex[2] = {-1, -1};
+
+    // Slot holding source row y, scaling it into a free slot if needed
+    auto fetch = [&](int y, int keepSlot) -> int {
+        for (int s = 0; s < 2; s++) {
+            if (cachedIndex[s] == y) {
+                return s;
+            }
+        }
+
+        // Evict the older row, unless the caller still needs it
+        int s = (cachedIndex[0] <= cachedIndex[1]) ? 0 : 1;
+        if (s == keepSlot) {
+            s ^= 1;
+        }
+
+        const uint8_t* srcRow = src + static_cast<ptrdiff_t>(y) * srcStride;
+        if (sameWidth) {
+            cachedRow[s] = srcRow;
+        } else {
+            uint8_t* out = scratch.data + static_cast<size_t>(s) * rowBytes;
+            kernels.scaleRow(srcRow, plan.srcWidth, out, plan.columnIndex.data(),
+                             plan.columnWeight.data(), plan.dstWidth, bpp);
+            cachedRow[s] = out;
+        }
+        cachedIndex[s] = y;
+        return s;
+    };
+
+    for (int y = 0; y < plan.dstHeight; y++) {
+        const Tap& tap = plan.rows[y];
+        uint8_t* dstRow = dst + static_cast<ptrdiff_t>(y) * dstStride;
+
+        int s0 = fetch(tap.index0, -1);
+        if (tap.weight == 0) {
+            memcpy(dstRow, cachedRow[s0], rowBytes);
+            continue;
+        }
+
+        int s1 = fetch(tap.index1, s0);
+        kernels.blendRows(cachedRow[s0], cachedRow[s1], dstRow,
+                          rowBytes, tap.weight);
+    }
+}
+
+} // namespace FrameScaler
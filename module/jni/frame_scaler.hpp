@@ -0,0 +1,53 @@
+/*
+ * DroidFakeCam - Frame Scaler Header
+ *
+ * Separable fixed-point bilinear scaling. The per-column and per-row
+ * source indices and weights for a (source size -> target size) pair are
+ * computed once into a Plan and cached, since a capture session scales
+ * between the same two sizes for every frame.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace FrameScaler {
+
+// Two source taps and the Q8 weight of the second one
+struct Tap {
+    int32_t index0;
+    int32_t index1;
+    uint16_t weight;  // 0..255, weight of index1; index0 gets 256 - weight
+};
+
+struct Plan {
+    int srcWidth;
+    int srcHeight;
+    int dstWidth;
+    int dstHeight;
+    std::vector<Tap> columns;  // One per destination column
+    std::vector<Tap> rows;     // One per destination row
+
+    // The columns' index0 and weight as separate arrays, the layout
+    // FrameSimd scaleRow reads
+    std::vector<int32_t> columnIndex;
+    std::vector<uint8_t> columnWeight;
+};
+
+// Get the (cached) plan for scaling srcWidth x srcHeight to
+// dstWidth x dstHeight. Plans are immutable and safe to share.
+std::shared_ptr<const Plan> getPlan(int srcWidth, int srcHeight,
+                                    int dstWidth, int dstHeight);
+
+// Scale one plane of interleaved 8-bit samples with `bpp` bytes per pixel
+// (1 = Y, 2 = interleaved UV, 3 = RGB, 4 = RGBA). Strides are in bytes;
+// a negative one walks the plane bottom-up.
+void scalePlane(const Plan& plan, int bpp,
+                const uint8_t* src, int srcStride,
+                uint8_t* dst, int dstStride);
+
+} // namespace FrameScaler
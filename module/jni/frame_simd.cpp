@@ -0,0 +1,1471 @@
+/*
+ * DroidFakeCam - SIMD Kernels Implementation
+ *
+ * Every vector kernel handles whole 16-pixel blocks and finishes each row
+ * with the scalar code, so arbitrary widths are supported. The integer
+ * arithmetic mirrors the scalar formulas exactly (same coefficients, same
+ * rounding, saturation in place of clamp()), so the output is identical
+ * whichever kernel set runs.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_simd.hpp"
+#include <android/log.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DFC_HAVE_NEON 1
+#include <arm_neon.h>
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+#elif defined(__i386__) || defined(__x86_64__)
+#define DFC_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+namespace FrameSimd {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Scalar reference (BT.601 studio swing, 8-bit fixed point)
+// ---------------------------------------------------------------------------
+
+inline uint8_t clamp(int val) {
+    return static_cast<uint8_t>(std::max(0, std::min(255, val)));
+}
+
+// Results are always within [16, 240], no clamping needed
+inline uint8_t rgbToY(int r, int g, int b) {
+    return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+inline uint8_t rgbToU(int r, int g, int b) {
+    return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+inline uint8_t rgbToV(int r, int g, int b) {
+    return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+// Luma for pixels [x0, width) of one row
+void lumaRow(const uint8_t* rgb, uint8_t* yRow, int x0, int width) {
+    for (int x = x0; x < width; x++) {
+        const uint8_t* p = rgb + x * 3;
+        yRow[x] = rgbToY(p[0], p[1], p[2]);
+    }
+}
+
+// Interleaved VU for even pixels in [x0, width); x0 must be even
+void vuRow(const uint8_t* rgb, uint8_t* vu, int x0, int width) {
+    for (int x = x0; x < width; x += 2) {
+        const uint8_t* p = rgb + x * 3;
+        vu[x] = rgbToV(p[0], p[1], p[2]);
+        vu[x + 1] = rgbToU(p[0], p[1], p[2]);
+    }
+}
+
+// Planar U and V for even pixels in [x0, width); x0 must be even
+void uvRow(const uint8_t* rgb, uint8_t* u, uint8_t* v, int x0, int width) {
+    for (int x = x0; x < width; x += 2) {
+        const uint8_t* p = rgb + x * 3;
+        u[x / 2] = rgbToU(p[0], p[1], p[2]);
+        v[x / 2] = rgbToV(p[0], p[1], p[2]);
+    }
+}
+
+// RGB for pixels [x0, width) of one row; x0 must be even
+void nv21Row(const uint8_t* yRow, const uint8_t* vu, uint8_t* rgb,
+             int x0, int width) {
+    for (int x = x0; x < width; x++) {
+        int c = yRow[x] - 16;
+        int v = vu[x & ~1] - 128;
+        int u = vu[(x & ~1) + 1] - 128;
+
+        uint8_t* p = rgb + x * 3;
+        p[0] = clamp((298 * c + 409 * v + 128) >> 8);
+        p[1] = clamp((298 * c - 100 * u - 208 * v + 128) >> 8);
+        p[2] = clamp((298 * c + 516 * u + 128) >> 8);
+    }
+}
+
+void rgbToNv21Scalar(const uint8_t* rgb, int rgbStride,
+                     uint8_t* yPlane, int yStride,
+                     uint8_t* vuPlane, int vuStride,
+                     int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        lumaRow(src, yPlane + j * yStride, 0, width);
+        if ((j & 1) == 0) {
+            vuRow(src, vuPlane + (j / 2) * vuStride, 0, width);
+        }
+    }
+}
+
+void rgbToI420Scalar(const uint8_t* rgb, int rgbStride,
+                     uint8_t* yPlane, int yStride,
+                     uint8_t* uPlane, int uStride,
+                     uint8_t* vPlane, int vStride,
+                     int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        lumaRow(src, yPlane + j * yStride, 0, width);
+        if ((j & 1) == 0) {
+            uvRow(src, uPlane + (j / 2) * uStride, vPlane + (j / 2) * vStride,
+                  0, width);
+        }
+    }
+}
+
+void nv21ToRgbScalar(const uint8_t* yPlane, int yStride,
+                     const uint8_t* vuPlane, int vuStride,
+                     uint8_t* rgb, int rgbStride,
+                     int width, int height) {
+    for (int j = 0; j < height; j++) {
+        nv21Row(yPlane + j * yStride, vuPlane + (j / 2) * vuStride,
+                rgb + j * rgbStride, 0, width);
+    }
+}
+
+void blendTail(const uint8_t* a, const uint8_t* b, uint8_t* dst,
+               int i, int count, int weight) {
+    int inv = 256 - weight;
+    for (; i < count; i++) {
+        dst[i] = static_cast<uint8_t>((a[i] * inv + b[i] * weight + 128) >> 8);
+    }
+}
+
+void blendRowsScalar(const uint8_t* a, const uint8_t* b, uint8_t* dst,
+                     int count, int weight) {
+    blendTail(a, b, dst, 0, count, weight);
+}
+
+template <int BPP>
+void scaleTailFixed(const uint8_t* src, uint8_t* dst, const int32_t* index,
+                    const uint8_t* weight, int x, int count) {
+    for (; x < count; x++) {
+        const uint8_t* p0 = src + index[x] * BPP;
+        int w1 = weight[x];
+        int w0 = 256 - w1;
+        // The last source pixel has no right neighbour, and a zero weight
+        const uint8_t* p1 = w1 ? p0 + BPP : p0;
+        uint8_t* out = dst + x * BPP;
+        for (int c = 0; c < BPP; c++) {
+            out[c] = static_cast<uint8_t>((p0[c] * w0 + p1[c] * w1 + 128) >> 8);
+        }
+    }
+}
+
+// Horizontal taps [x, count) of one row
+void scaleTail(const uint8_t* src, uint8_t* dst, const int32_t* index,
+               const uint8_t* weight, int x, int count, int bpp) {
+    switch (bpp) {
+    case 1: scaleTailFixed<1>(src, dst, index, weight, x, count); break;
+    case 2: scaleTailFixed<2>(src, dst, index, weight, x, count); break;
+    case 3: scaleTailFixed<3>(src, dst, index, weight, x, count); break;
+    default: scaleTailFixed<4>(src, dst, index, weight, x, count); break;
+    }
+}
+
+void scaleRowScalar(const uint8_t* src, int srcWidth, uint8_t* dst,
+                    const int32_t* index, const uint8_t* weight,
+                    int count, int bpp) {
+    (void)srcWidth;
+    scaleTail(src, dst, index, weight, 0, count, bpp);
+}
+
+template <int BPP>
+void transposeRectFixed(const uint8_t* src, int srcStride,
+                        uint8_t* dst, int dstStride,
+                        int x0, int y0, int width, int height) {
+    for (int y = y0; y < y0 + height; y++) {
+        const uint8_t* in = src + static_cast<ptrdiff_t>(y) * srcStride + x0 * BPP;
+        uint8_t* out = dst + static_cast<ptrdiff_t>(x0) * dstStride + y * BPP;
+        for (int x = 0; x < width; x++, in += BPP, out += dstStride) {
+            for (int c = 0; c < BPP; c++) {
+                out[c] = in[c];
+            }
+        }
+    }
+}
+
+// Transpose the width x height rectangle at (x0, y0) of the source
+void transposeRect(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride,
+                   int x0, int y0, int width, int height, int bpp) {
+    switch (bpp) {
+    case 1: transposeRectFixed<1>(src, srcStride, dst, dstStride, x0, y0, width, height); break;
+    case 2: transposeRectFixed<2>(src, srcStride, dst, dstStride, x0, y0, width, height); break;
+    case 3: transposeRectFixed<3>(src, srcStride, dst, dstStride, x0, y0, width, height); break;
+    default: transposeRectFixed<4>(src, srcStride, dst, dstStride, x0, y0, width, height); break;
+    }
+}
+
+// Square tiles small enough that the source rows read and the
+// destination rows written for one tile all stay in L1
+constexpr int kTransposeTile = 32;
+
+// Moves one 8x8-sample block: src points at its top-left sample, dst at
+// the matching position of the transposed plane
+using TransposeBlock = void (*)(const uint8_t* src, int srcStride,
+                                uint8_t* dst, int dstStride);
+
+// Walk the plane tile by tile, 8x8 blocks at a time through `block` (or
+// the scalar loop when there is none); ragged edges go through the
+// scalar loop
+void transposeTiled(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride,
+                    int width, int height, int bpp, TransposeBlock block) {
+    int blockWidth = block ? width & ~7 : width;
+    int blockHeight = block ? height & ~7 : height;
+
+    for (int ty = 0; ty < blockHeight; ty += kTransposeTile) {
+        int tileBottom = std::min(ty + kTransposeTile, blockHeight);
+        for (int tx = 0; tx < blockWidth; tx += kTransposeTile) {
+            int tileRight = std::min(tx + kTransposeTile, blockWidth);
+            if (!block) {
+                transposeRect(src, srcStride, dst, dstStride,
+                              tx, ty, tileRight - tx, tileBottom - ty, bpp);
+                continue;
+            }
+            for (int y = ty; y < tileBottom; y += 8) {
+                for (int x = tx; x < tileRight; x += 8) {
+                    block(src + static_cast<ptrdiff_t>(y) * srcStride + x * bpp, srcStride,
+                          dst + static_cast<ptrdiff_t>(x) * dstStride + y * bpp, dstStride);
+                }
+            }
+        }
+    }
+
+    if (blockWidth < width) {
+        transposeRect(src, srcStride, dst, dstStride,
+                      blockWidth, 0, width - blockWidth, height, bpp);
+    }
+    if (blockHeight < height) {
+        transposeRect(src, srcStride, dst, dstStride,
+                      0, blockHeight, blockWidth, height - blockHeight, bpp);
+    }
+}
+
+void transposeScalar(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride,
+                     int width, int height, int bpp) {
+    transposeTiled(src, srcStride, dst, dstStride, width, height, bpp, nullptr);
+}
+
+const Kernels kScalarKernels = {
+    Isa::Scalar,
+    rgbToNv21Scalar,
+    rgbToI420Scalar,
+    nv21ToRgbScalar,
+    blendRowsScalar,
+    scaleRowScalar,
+    transposeScalar,
+};
+
+#if defined(DFC_HAVE_NEON) || defined(DFC_HAVE_X86)
+// ---------------------------------------------------------------------------
+// Horizontal scaler taps, shared by the vector kernel sets: each tap's two
+// source pixels are fetched with 4-byte loads into one 32-bit lane (bytes
+// [0, bpp) = left pixel), blended bytewise with the tap's weight repeated
+// across the lane, then the lanes are packed back to bpp bytes per pixel.
+// ---------------------------------------------------------------------------
+
+inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Leading taps whose 4-byte loads (of the left pixel and, for 3 and 4
+// bytes per pixel, of the right one) stay inside the `srcWidth`-pixel
+// row. index never decreases, so only the last few taps can run past.
+int scaleVectorTaps(const int32_t* index, int srcWidth, int count, int bpp) {
+    int64_t rowBytes = static_cast<int64_t>(srcWidth) * bpp;
+    int n = count;
+    while (n > 0 && static_cast<int64_t>(index[n - 1]) * bpp + bpp + 4 > rowBytes) {
+        n--;
+    }
+    return n;
+}
+
+// Byte shuffles packing four 32-bit lanes down to their first bpp bytes,
+// [bpp - 1][byte]. Index 0x80 (out of range) gives zero on both ISAs.
+struct ScalePackMasks {
+    uint8_t m[4][16];
+};
+
+constexpr ScalePackMasks makeScalePackMasks() {
+    ScalePackMasks masks = {};
+    for (int bpp = 1; bpp <= 4; bpp++) {
+        for (int i = 0; i < 16; i++) {
+            masks.m[bpp - 1][i] = i < 4 * bpp
+                ? static_cast<uint8_t>((i / bpp) * 4 + i % bpp) : 0x80;
+        }
+    }
+    return masks;
+}
+
+alignas(16) constexpr ScalePackMasks kScalePack = makeScalePackMasks();
+#endif
+
+#if defined(DFC_HAVE_NEON)
+// ---------------------------------------------------------------------------
+// NEON (arm64, and armeabi-v7a when the CPU reports it)
+// ---------------------------------------------------------------------------
+
+// Luma for 16 pixels
+inline uint8x16_t lumaNeon(const uint8x16x3_t& px) {
+    uint16x8_t lo = vmull_u8(vget_low_u8(px.val[0]), vdup_n_u8(66));
+    lo = vmlal_u8(lo, vget_low_u8(px.val[1]), vdup_n_u8(129));
+    lo = vmlal_u8(lo, vget_low_u8(px.val[2]), vdup_n_u8(25));
+    uint16x8_t hi = vmull_u8(vget_high_u8(px.val[0]), vdup_n_u8(66));
+    hi = vmlal_u8(hi, vget_high_u8(px.val[1]), vdup_n_u8(129));
+    hi = vmlal_u8(hi, vget_high_u8(px.val[2]), vdup_n_u8(25));
+
+    // vrshrn: (x + 128) >> 8
+    uint8x16_t y = vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8));
+    return vaddq_u8(y, vdupq_n_u8(16));
+}
+
+// U and V (as 16-bit lanes) for the 8 even pixels of a 16-pixel block
+inline void chromaNeon(const uint8x16x3_t& px, int16x8_t& u, int16x8_t& v) {
+    const uint16x8_t evenMask = vdupq_n_u16(0x00FF);
+    int16x8_t r = vreinterpretq_s16_u16(
+        vandq_u16(vreinterpretq_u16_u8(px.val[0]), evenMask));
+    int16x8_t g = vreinterpretq_s16_u16(
+        vandq_u16(vreinterpretq_u16_u8(px.val[1]), evenMask));
+    int16x8_t b = vreinterpretq_s16_u16(
+        vandq_u16(vreinterpretq_u16_u8(px.val[2]), evenMask));
+    const int16x8_t bias = vdupq_n_s16(128);
+
+    u = vmulq_n_s16(b, 112);
+    u = vmlsq_n_s16(u, r, 38);
+    u = vmlsq_n_s16(u, g, 74);
+    u = vaddq_s16(vshrq_n_s16(vaddq_s16(u, bias), 8), bias);
+
+    v = vmulq_n_s16(r, 112);
+    v = vmlsq_n_s16(v, g, 94);
+    v = vmlsq_n_s16(v, b, 18);
+    v = vaddq_s16(vshrq_n_s16(vaddq_s16(v, bias), 8), bias);
+}
+
+void rgbToNv21Neon(const uint8_t* rgb, int rgbStride,
+                   uint8_t* yPlane, int yStride,
+                   uint8_t* vuPlane, int vuStride,
+                   int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        uint8_t* yRow = yPlane + j * yStride;
+        uint8_t* vu = ((j & 1) == 0) ? vuPlane + (j / 2) * vuStride : nullptr;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x3_t px = vld3q_u8(src + x * 3);
+            vst1q_u8(yRow + x, lumaNeon(px));
+
+            if (vu) {
+                int16x8_t u, v;
+                chromaNeon(px, u, v);
+                uint16x8_t pairs = vorrq_u16(vreinterpretq_u16_s16(v),
+                                             vshlq_n_u16(vreinterpretq_u16_s16(u), 8));
+                vst1q_u8(vu + x, vreinterpretq_u8_u16(pairs));
+            }
+        }
+
+        lumaRow(src, yRow, x, width);
+        if (vu) {
+            vuRow(src, vu, x, width);
+        }
+    }
+}
+
+void rgbToI420Neon(const uint8_t* rgb, int rgbStride,
+                   uint8_t* yPlane, int yStride,
+                   uint8_t* uPlane, int uStride,
+                   uint8_t* vPlane, int vStride,
+                   int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        uint8_t* yRow = yPlane + j * yStride;
+        bool chromaRow = (j & 1) == 0;
+        uint8_t* uRow = uPlane + (j / 2) * uStride;
+        uint8_t* vRow = vPlane + (j / 2) * vStride;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16x3_t px = vld3q_u8(src + x * 3);
+            vst1q_u8(yRow + x, lumaNeon(px));
+
+            if (chromaRow) {
+                int16x8_t u, v;
+                chromaNeon(px, u, v);
+                vst1_u8(uRow + x / 2, vmovn_u16(vreinterpretq_u16_s16(u)));
+                vst1_u8(vRow + x / 2, vmovn_u16(vreinterpretq_u16_s16(v)));
+            }
+        }
+
+        lumaRow(src, yRow, x, width);
+        if (chromaRow) {
+            uvRow(src, uRow, vRow, x, width);
+        }
+    }
+}
+
+// R, G, B for 8 pixels given luma and per-pixel chroma
+inline void yuvToRgbNeon(uint8x8_t y, uint8x8_t u8, uint8x8_t v8,
+                         uint8x8_t& r, uint8x8_t& g, uint8x8_t& b) {
+    int16x8_t c = vreinterpretq_s16_u16(vsubl_u8(y, vdup_n_u8(16)));
+    int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(u8, vdup_n_u8(128)));
+    int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(v8, vdup_n_u8(128)));
+
+    int16x4_t cl = vget_low_s16(c), ch = vget_high_s16(c);
+    int16x4_t ul = vget_low_s16(u), uh = vget_high_s16(u);
+    int16x4_t vl = vget_low_s16(v), vh = vget_high_s16(v);
+
+    int32x4_t rl = vmlal_n_s16(vmull_n_s16(cl, 298), vl, 409);
+    int32x4_t rh = vmlal_n_s16(vmull_n_s16(ch, 298), vh, 409);
+    int32x4_t gl = vmlsl_n_s16(vmlsl_n_s16(vmull_n_s16(cl, 298), ul, 100), vl, 208);
+    int32x4_t gh = vmlsl_n_s16(vmlsl_n_s16(vmull_n_s16(ch, 298), uh, 100), vh, 208);
+    int32x4_t bl = vmlal_n_s16(vmull_n_s16(cl, 298), ul, 516);
+    int32x4_t bh = vmlal_n_s16(vmull_n_s16(ch, 298), uh, 516);
+
+    // vqrshrn: (x + 128) >> 8, then vqmovun clamps to [0, 255]
+    r = vqmovun_s16(vcombine_s16(vqrshrn_n_s32(rl, 8), vqrshrn_n_s32(rh, 8)));
+    g = vqmovun_s16(vcombine_s16(vqrshrn_n_s32(gl, 8), vqrshrn_n_s32(gh, 8)));
+    b = vqmovun_s16(vcombine_s16(vqrshrn_n_s32(bl, 8), vqrshrn_n_s32(bh, 8)));
+}
+
+void nv21ToRgbNeon(const uint8_t* yPlane, int yStride,
+                   const uint8_t* vuPlane, int vuStride,
+                   uint8_t* rgb, int rgbStride,
+                   int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* yRow = yPlane + j * yStride;
+        const uint8_t* vu = vuPlane + (j / 2) * vuStride;
+        uint8_t* dst = rgb + j * rgbStride;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t y = vld1q_u8(yRow + x);
+            uint8x8x2_t chroma = vld2_u8(vu + x);  // val[0] = V, val[1] = U
+            uint8x8x2_t v = vzip_u8(chroma.val[0], chroma.val[0]);
+            uint8x8x2_t u = vzip_u8(chroma.val[1], chroma.val[1]);
+
+            uint8x8_t r0, g0, b0, r1, g1, b1;
+            yuvToRgbNeon(vget_low_u8(y), u.val[0], v.val[0], r0, g0, b0);
+            yuvToRgbNeon(vget_high_u8(y), u.val[1], v.val[1], r1, g1, b1);
+
+            uint8x16x3_t px;
+            px.val[0] = vcombine_u8(r0, r1);
+            px.val[1] = vcombine_u8(g0, g1);
+            px.val[2] = vcombine_u8(b0, b1);
+            vst3q_u8(dst + x * 3, px);
+        }
+
+        nv21Row(yRow, vu, dst, x, width);
+    }
+}
+
+void blendRowsNeon(const uint8_t* a, const uint8_t* b, uint8_t* dst,
+                   int count, int weight) {
+    uint8x8_t wa = vdup_n_u8(static_cast<uint8_t>(256 - weight));
+    uint8x8_t wb = vdup_n_u8(static_cast<uint8_t>(weight));
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t va = vld1q_u8(a + i);
+        uint8x16_t vb = vld1q_u8(b + i);
+        uint16x8_t lo = vmlal_u8(vmull_u8(vget_low_u8(va), wa), vget_low_u8(vb), wb);
+        uint16x8_t hi = vmlal_u8(vmull_u8(vget_high_u8(va), wa), vget_high_u8(vb), wb);
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+    }
+    blendTail(a, b, dst, i, count, weight);
+}
+
+// Pack each 32-bit lane down to its first bpp bytes (kScalePack)
+inline uint8x16_t scalePackNeon(uint8x16_t v, uint8x16_t mask) {
+#if defined(__aarch64__)
+    return vqtbl1q_u8(v, mask);
+#else
+    uint8x8x2_t table = {{vget_low_u8(v), vget_high_u8(v)}};
+    return vcombine_u8(vtbl2_u8(table, vget_low_u8(mask)),
+                       vtbl2_u8(table, vget_high_u8(mask)));
+#endif
+}
+
+// (p0 * (256 - w) + p1 * w + 128) >> 8 as p0 * 256 - p0 * w + p1 * w,
+// since 256 does not fit a byte; no partial sum leaves 0..65280
+inline uint8x8_t scaleBlendNeon(uint8x8_t p0, uint8x8_t p1, uint8x8_t w) {
+    uint16x8_t acc = vmlsl_u8(vshll_n_u8(p0, 8), p0, w);
+    return vrshrn_n_u16(vmlal_u8(acc, p1, w), 8);
+}
+
+void scaleRowNeon(const uint8_t* src, int srcWidth, uint8_t* dst,
+                  const int32_t* index, const uint8_t* weight,
+                  int count, int bpp) {
+    int n = scaleVectorTaps(index, srcWidth, count, bpp);
+    uint8x16_t pack = vld1q_u8(kScalePack.m[bpp - 1]);
+    int32x4_t nextPixel = vdupq_n_s32(-8 * bpp);  // Right shift by one pixel
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        uint32_t left[4];
+        uint32_t right[4];
+        for (int k = 0; k < 4; k++) {
+            const uint8_t* p = src + index[x + k] * bpp;
+            left[k] = load32(p);
+            right[k] = bpp > 2 ? load32(p + bpp) : 0;
+        }
+        uint32x4_t l = vld1q_u32(left);
+        uint8x16_t p0 = vreinterpretq_u8_u32(l);
+        uint8x16_t p1 = vreinterpretq_u8_u32(bpp > 2 ? vld1q_u32(right)
+                                                     : vshlq_u32(l, nextPixel));
+
+        // weight[x + k] in every byte of lane k
+        uint8x8_t w4 = vreinterpret_u8_u32(vdup_n_u32(load32(weight + x)));
+        uint8x8x2_t w2 = vzip_u8(w4, w4);
+        uint8x8x2_t w = vzip_u8(w2.val[0], w2.val[0]);
+
+        uint8x16_t out = vcombine_u8(
+            scaleBlendNeon(vget_low_u8(p0), vget_low_u8(p1), w.val[0]),
+            scaleBlendNeon(vget_high_u8(p0), vget_high_u8(p1), w.val[1]));
+        uint8_t packed[16];
+        vst1q_u8(packed, scalePackNeon(out, pack));
+        memcpy(dst + x * bpp, packed, 4 * bpp);
+    }
+    scaleTail(src, dst, index, weight, x, count, bpp);
+}
+
+void transposeBlock8Neon(const uint8_t* src, int srcStride,
+                         uint8_t* dst, int dstStride) {
+    uint8x8_t r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = vld1_u8(src + i * srcStride);
+    }
+
+    // Swap 1-, 2- then 4-byte elements between row pairs
+    uint8x8x2_t b0 = vtrn_u8(r[0], r[1]);
+    uint8x8x2_t b1 = vtrn_u8(r[2], r[3]);
+    uint8x8x2_t b2 = vtrn_u8(r[4], r[5]);
+    uint8x8x2_t b3 = vtrn_u8(r[6], r[7]);
+
+    uint16x4x2_t h0 = vtrn_u16(vreinterpret_u16_u8(b0.val[0]), vreinterpret_u16_u8(b1.val[0]));
+    uint16x4x2_t h1 = vtrn_u16(vreinterpret_u16_u8(b0.val[1]), vreinterpret_u16_u8(b1.val[1]));
+    uint16x4x2_t h2 = vtrn_u16(vreinterpret_u16_u8(b2.val[0]), vreinterpret_u16_u8(b3.val[0]));
+    uint16x4x2_t h3 = vtrn_u16(vreinterpret_u16_u8(b2.val[1]), vreinterpret_u16_u8(b3.val[1]));
+
+    uint32x2x2_t w0 = vtrn_u32(vreinterpret_u32_u16(h0.val[0]), vreinterpret_u32_u16(h2.val[0]));
+    uint32x2x2_t w1 = vtrn_u32(vreinterpret_u32_u16(h1.val[0]), vreinterpret_u32_u16(h3.val[0]));
+    uint32x2x2_t w2 = vtrn_u32(vreinterpret_u32_u16(h0.val[1]), vreinterpret_u32_u16(h2.val[1]));
+    uint32x2x2_t w3 = vtrn_u32(vreinterpret_u32_u16(h1.val[1]), vreinterpret_u32_u16(h3.val[1]));
+
+    vst1_u8(dst + 0 * dstStride, vreinterpret_u8_u32(w0.val[0]));
+    vst1_u8(dst + 1 * dstStride, vreinterpret_u8_u32(w1.val[0]));
+    vst1_u8(dst + 2 * dstStride, vreinterpret_u8_u32(w2.val[0]));
+    vst1_u8(dst + 3 * dstStride, vreinterpret_u8_u32(w3.val[0]));
+    vst1_u8(dst + 4 * dstStride, vreinterpret_u8_u32(w0.val[1]));
+    vst1_u8(dst + 5 * dstStride, vreinterpret_u8_u32(w1.val[1]));
+    vst1_u8(dst + 6 * dstStride, vreinterpret_u8_u32(w2.val[1]));
+    vst1_u8(dst + 7 * dstStride, vreinterpret_u8_u32(w3.val[1]));
+}
+
+void transposeBlock16Neon(const uint8_t* src, int srcStride,
+                          uint8_t* dst, int dstStride) {
+    uint16x8_t r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i * srcStride));
+    }
+
+    uint16x8x2_t b0 = vtrnq_u16(r[0], r[1]);
+    uint16x8x2_t b1 = vtrnq_u16(r[2], r[3]);
+    uint16x8x2_t b2 = vtrnq_u16(r[4], r[5]);
+    uint16x8x2_t b3 = vtrnq_u16(r[6], r[7]);
+
+    uint32x4x2_t w0 = vtrnq_u32(vreinterpretq_u32_u16(b0.val[0]), vreinterpretq_u32_u16(b1.val[0]));
+    uint32x4x2_t w1 = vtrnq_u32(vreinterpretq_u32_u16(b0.val[1]), vreinterpretq_u32_u16(b1.val[1]));
+    uint32x4x2_t w2 = vtrnq_u32(vreinterpretq_u32_u16(b2.val[0]), vreinterpretq_u32_u16(b3.val[0]));
+    uint32x4x2_t w3 = vtrnq_u32(vreinterpretq_u32_u16(b2.val[1]), vreinterpretq_u32_u16(b3.val[1]));
+
+    // Final step swaps 64-bit halves between rows i and i + 4
+    uint32x4_t rows[8] = {
+        vcombine_u32(vget_low_u32(w0.val[0]), vget_low_u32(w2.val[0])),
+        vcombine_u32(vget_low_u32(w1.val[0]), vget_low_u32(w3.val[0])),
+        vcombine_u32(vget_low_u32(w0.val[1]), vget_low_u32(w2.val[1])),
+        vcombine_u32(vget_low_u32(w1.val[1]), vget_low_u32(w3.val[1])),
+        vcombine_u32(vget_high_u32(w0.val[0]), vget_high_u32(w2.val[0])),
+        vcombine_u32(vget_high_u32(w1.val[0]), vget_high_u32(w3.val[0])),
+        vcombine_u32(vget_high_u32(w0.val[1]), vget_high_u32(w2.val[1])),
+        vcombine_u32(vget_high_u32(w1.val[1]), vget_high_u32(w3.val[1])),
+    };
+    for (int i = 0; i < 8; i++) {
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + i * dstStride), rows[i]);
+    }
+}
+
+inline void transpose4x4x32Neon(const uint8_t* src, int srcStride,
+                                uint8_t* dst, int dstStride) {
+    uint32x4_t r[4];
+    for (int i = 0; i < 4; i++) {
+        r[i] = vld1q_u32(reinterpret_cast<const uint32_t*>(src + i * srcStride));
+    }
+
+    uint32x4x2_t t0 = vtrnq_u32(r[0], r[1]);
+    uint32x4x2_t t1 = vtrnq_u32(r[2], r[3]);
+
+    uint32x4_t rows[4] = {
+        vcombine_u32(vget_low_u32(t0.val[0]), vget_low_u32(t1.val[0])),
+        vcombine_u32(vget_low_u32(t0.val[1]), vget_low_u32(t1.val[1])),
+        vcombine_u32(vget_high_u32(t0.val[0]), vget_high_u32(t1.val[0])),
+        vcombine_u32(vget_high_u32(t0.val[1]), vget_high_u32(t1.val[1])),
+    };
+    for (int i = 0; i < 4; i++) {
+        vst1q_u32(reinterpret_cast<uint32_t*>(dst + i * dstStride), rows[i]);
+    }
+}
+
+void transposeBlock32Neon(const uint8_t* src, int srcStride,
+                          uint8_t* dst, int dstStride) {
+    for (int y = 0; y < 8; y += 4) {
+        for (int x = 0; x < 8; x += 4) {
+            transpose4x4x32Neon(src + y * srcStride + x * 4, srcStride,
+                                dst + x * dstStride + y * 4, dstStride);
+        }
+    }
+}
+
+void transposeNeon(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride,
+                   int width, int height, int bpp) {
+    TransposeBlock block = nullptr;
+    if (bpp == 1) block = transposeBlock8Neon;
+    else if (bpp == 2) block = transposeBlock16Neon;
+    else if (bpp == 4) block = transposeBlock32Neon;
+    transposeTiled(src, srcStride, dst, dstStride, width, height, bpp, block);
+}
+
+const Kernels kNeonKernels = {
+    Isa::Neon,
+    rgbToNv21Neon,
+    rgbToI420Neon,
+    nv21ToRgbNeon,
+    blendRowsNeon,
+    scaleRowNeon,
+    transposeNeon,
+};
+
+#if !defined(__aarch64__)
+// HWCAP_NEON from <asm/hwcap.h> (32-bit ARM)
+constexpr unsigned long kHwcapNeon = 1 << 12;
+#endif
+
+#endif // DFC_HAVE_NEON
+
+#if defined(DFC_HAVE_X86)
+// ---------------------------------------------------------------------------
+// x86: SSE4.1 (baseline on x86_64 Android) and AVX2, selected at runtime
+// ---------------------------------------------------------------------------
+
+#define DFC_SSE41 __attribute__((target("sse4.1")))
+#define DFC_AVX2 __attribute__((target("avx2")))
+
+// pshufb masks converting 16 packed RGB24 pixels (3 registers) to and
+// from 16 bytes per channel: [channel][register][byte]
+struct ShuffleMasks {
+    uint8_t m[3][3][16];
+};
+
+constexpr ShuffleMasks makeShuffleMasks(bool interleave) {
+    ShuffleMasks masks = {};
+    for (int c = 0; c < 3; c++) {
+        for (int reg = 0; reg < 3; reg++) {
+            for (int i = 0; i < 16; i++) {
+                uint8_t idx = 0x80;  // Zero this byte
+                if (!interleave) {
+                    // Channel c of pixel i sits at packed byte 3 * i + c
+                    int src = 3 * i + c;
+                    if (src / 16 == reg) {
+                        idx = static_cast<uint8_t>(src % 16);
+                    }
+                } else {
+                    // Packed byte i of register reg is channel (n % 3) of pixel n / 3
+                    int n = 16 * reg + i;
+                    if (n % 3 == c) {
+                        idx = static_cast<uint8_t>(n / 3);
+                    }
+                }
+                masks.m[c][reg][i] = idx;
+            }
+        }
+    }
+    return masks;
+}
+
+alignas(16) constexpr ShuffleMasks kDeinterleave = makeShuffleMasks(false);
+alignas(16) constexpr ShuffleMasks kInterleave = makeShuffleMasks(true);
+
+DFC_SSE41 inline __m128i loadMask(const uint8_t* mask) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+}
+
+DFC_SSE41 inline void deinterleaveRgb(const uint8_t* p,
+                                      __m128i& r, __m128i& g, __m128i& b) {
+    __m128i a[3];
+    for (int reg = 0; reg < 3; reg++) {
+        a[reg] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * reg));
+    }
+
+    __m128i* out[3] = {&r, &g, &b};
+    for (int c = 0; c < 3; c++) {
+        *out[c] = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(a[0], loadMask(kDeinterleave.m[c][0])),
+                         _mm_shuffle_epi8(a[1], loadMask(kDeinterleave.m[c][1]))),
+            _mm_shuffle_epi8(a[2], loadMask(kDeinterleave.m[c][2])));
+    }
+}
+
+DFC_SSE41 inline void interleaveRgb(uint8_t* p,
+                                    __m128i r, __m128i g, __m128i b) {
+    for (int reg = 0; reg < 3; reg++) {
+        __m128i out = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(r, loadMask(kInterleave.m[0][reg])),
+                         _mm_shuffle_epi8(g, loadMask(kInterleave.m[1][reg]))),
+            _mm_shuffle_epi8(b, loadMask(kInterleave.m[2][reg])));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16 * reg), out);
+    }
+}
+
+// madd_epi16 operand holding the coefficient pair (a, b) in every lane
+DFC_SSE41 inline __m128i pairConst(int a, int b) {
+    return _mm_set1_epi32(static_cast<int32_t>(
+        (static_cast<uint32_t>(static_cast<uint16_t>(b)) << 16) |
+        static_cast<uint16_t>(a)));
+}
+
+// Luma for 8 pixels held as 16-bit lanes
+DFC_SSE41 inline __m128i lumaSse(__m128i r, __m128i g, __m128i b) {
+    __m128i acc = _mm_mullo_epi16(r, _mm_set1_epi16(66));
+    acc = _mm_add_epi16(acc, _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    acc = _mm_add_epi16(acc, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    // Fits in 16 unsigned bits, so a logical shift matches the scalar code
+    acc = _mm_srli_epi16(_mm_add_epi16(acc, _mm_set1_epi16(128)), 8);
+    return _mm_add_epi16(acc, _mm_set1_epi16(16));
+}
+
+// U and V (16-bit lanes) for the 8 even pixels of a 16-pixel block
+DFC_SSE41 inline void chromaSse(__m128i r8, __m128i g8, __m128i b8,
+                                __m128i& u, __m128i& v) {
+    const __m128i evenMask = _mm_set1_epi16(0x00FF);
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i r = _mm_and_si128(r8, evenMask);
+    __m128i g = _mm_and_si128(g8, evenMask);
+    __m128i b = _mm_and_si128(b8, evenMask);
+
+    u = _mm_mullo_epi16(b, _mm_set1_epi16(112));
+    u = _mm_sub_epi16(u, _mm_mullo_epi16(r, _mm_set1_epi16(38)));
+    u = _mm_sub_epi16(u, _mm_mullo_epi16(g, _mm_set1_epi16(74)));
+    u = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(u, bias), 8), bias);
+
+    v = _mm_mullo_epi16(r, _mm_set1_epi16(112));
+    v = _mm_sub_epi16(v, _mm_mullo_epi16(g, _mm_set1_epi16(94)));
+    v = _mm_sub_epi16(v, _mm_mullo_epi16(b, _mm_set1_epi16(18)));
+    v = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(v, bias), 8), bias);
+}
+
+DFC_SSE41 inline __m128i luma16Sse(__m128i r8, __m128i g8, __m128i b8) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = lumaSse(_mm_cvtepu8_epi16(r8), _mm_cvtepu8_epi16(g8),
+                         _mm_cvtepu8_epi16(b8));
+    __m128i hi = lumaSse(_mm_unpackhi_epi8(r8, zero), _mm_unpackhi_epi8(g8, zero),
+                         _mm_unpackhi_epi8(b8, zero));
+    return _mm_packus_epi16(lo, hi);
+}
+
+// Y (and, for chroma rows, VU) for pixels [x, x + 16)
+DFC_SSE41 inline void rgbToNv21Block(const uint8_t* src, uint8_t* yRow,
+                                     uint8_t* vu, int x) {
+    __m128i r, g, b;
+    deinterleaveRgb(src + x * 3, r, g, b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(yRow + x), luma16Sse(r, g, b));
+
+    if (vu) {
+        __m128i u, v;
+        chromaSse(r, g, b, u, v);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(vu + x),
+                         _mm_or_si128(v, _mm_slli_epi16(u, 8)));
+    }
+}
+
+// Y (and, for chroma rows, U and V) for pixels [x, x + 16)
+DFC_SSE41 inline void rgbToI420Block(const uint8_t* src, uint8_t* yRow,
+                                     uint8_t* uRow, uint8_t* vRow, int x) {
+    __m128i r, g, b;
+    deinterleaveRgb(src + x * 3, r, g, b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(yRow + x), luma16Sse(r, g, b));
+
+    if (uRow) {
+        __m128i u, v;
+        chromaSse(r, g, b, u, v);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(uRow + x / 2),
+                         _mm_packus_epi16(u, u));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(vRow + x / 2),
+                         _mm_packus_epi16(v, v));
+    }
+}
+
+DFC_SSE41 void rgbToNv21Sse41(const uint8_t* rgb, int rgbStride,
+                              uint8_t* yPlane, int yStride,
+                              uint8_t* vuPlane, int vuStride,
+                              int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        uint8_t* yRow = yPlane + j * yStride;
+        uint8_t* vu = ((j & 1) == 0) ? vuPlane + (j / 2) * vuStride : nullptr;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            rgbToNv21Block(src, yRow, vu, x);
+        }
+
+        lumaRow(src, yRow, x, width);
+        if (vu) {
+            vuRow(src, vu, x, width);
+        }
+    }
+}
+
+DFC_SSE41 void rgbToI420Sse41(const uint8_t* rgb, int rgbStride,
+                              uint8_t* yPlane, int yStride,
+                              uint8_t* uPlane, int uStride,
+                              uint8_t* vPlane, int vStride,
+                              int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        uint8_t* yRow = yPlane + j * yStride;
+        bool chromaRow = (j & 1) == 0;
+        uint8_t* uRow = uPlane + (j / 2) * uStride;
+        uint8_t* vRow = vPlane + (j / 2) * vStride;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            rgbToI420Block(src, yRow, chromaRow ? uRow : nullptr, vRow, x);
+        }
+
+        lumaRow(src, yRow, x, width);
+        if (chromaRow) {
+            uvRow(src, uRow, vRow, x, width);
+        }
+    }
+}
+
+// R, G, B (16-bit lanes) for 8 pixels given biased luma and chroma
+DFC_SSE41 inline void yuvToRgbSse(__m128i c, __m128i u, __m128i v,
+                                  __m128i& r, __m128i& g, __m128i& b) {
+    const __m128i round = _mm_set1_epi32(128);
+    const __m128i one = _mm_set1_epi16(1);
+
+    __m128i cvLo = _mm_unpacklo_epi16(c, v), cvHi = _mm_unpackhi_epi16(c, v);
+    __m128i cuLo = _mm_unpacklo_epi16(c, u), cuHi = _mm_unpackhi_epi16(c, u);
+    __m128i v1Lo = _mm_unpacklo_epi16(v, one), v1Hi = _mm_unpackhi_epi16(v, one);
+
+    // 298c + 409v + 128
+    const __m128i kR = pairConst(298, 409);
+    r = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cvLo, kR), round), 8),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cvHi, kR), round), 8));
+
+    // 298c - 100u  +  -208v + 128 * 1
+    const __m128i kG0 = pairConst(298, -100);
+    const __m128i kG1 = pairConst(-208, 128);
+    g = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cuLo, kG0),
+                                     _mm_madd_epi16(v1Lo, kG1)), 8),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cuHi, kG0),
+                                     _mm_madd_epi16(v1Hi, kG1)), 8));
+
+    // 298c + 516u + 128
+    const __m128i kB = pairConst(298, 516);
+    b = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cuLo, kB), round), 8),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(cuHi, kB), round), 8));
+}
+
+DFC_SSE41 void nv21ToRgbSse41(const uint8_t* yPlane, int yStride,
+                              const uint8_t* vuPlane, int vuStride,
+                              uint8_t* rgb, int rgbStride,
+                              int width, int height) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i evenMask = _mm_set1_epi16(0x00FF);
+    const __m128i lumaBias = _mm_set1_epi16(16);
+    const __m128i chromaBias = _mm_set1_epi16(128);
+
+    for (int j = 0; j < height; j++) {
+        const uint8_t* yRow = yPlane + j * yStride;
+        const uint8_t* vu = vuPlane + (j / 2) * vuStride;
+        uint8_t* dst = rgb + j * rgbStride;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(yRow + x));
+            __m128i vu8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vu + x));
+
+            __m128i v = _mm_sub_epi16(_mm_and_si128(vu8, evenMask), chromaBias);
+            __m128i u = _mm_sub_epi16(_mm_srli_epi16(vu8, 8), chromaBias);
+            __m128i cLo = _mm_sub_epi16(_mm_cvtepu8_epi16(y8), lumaBias);
+            __m128i cHi = _mm_sub_epi16(_mm_unpackhi_epi8(y8, zero), lumaBias);
+
+            __m128i rLo, gLo, bLo, rHi, gHi, bHi;
+            yuvToRgbSse(cLo, _mm_unpacklo_epi16(u, u), _mm_unpacklo_epi16(v, v),
+                        rLo, gLo, bLo);
+            yuvToRgbSse(cHi, _mm_unpackhi_epi16(u, u), _mm_unpackhi_epi16(v, v),
+                        rHi, gHi, bHi);
+
+            interleaveRgb(dst + x * 3, _mm_packus_epi16(rLo, rHi),
+                          _mm_packus_epi16(gLo, gHi), _mm_packus_epi16(bLo, bHi));
+        }
+
+        nv21Row(yRow, vu, dst, x, width);
+    }
+}
+
+// 16-bit products stay below 65536: 255 * 256 + 128
+DFC_SSE41 void blendRowsSse41(const uint8_t* a, const uint8_t* b, uint8_t* dst,
+                              int count, int weight) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16(static_cast<int16_t>(256 - weight));
+    const __m128i wb = _mm_set1_epi16(static_cast<int16_t>(weight));
+    const __m128i round = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i lo = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                          _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb)), round);
+        __m128i hi = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                          _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb)), round);
+        __m128i out = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), out);
+    }
+    blendTail(a, b, dst, i, count, weight);
+}
+
+// Four taps per iteration: lanes filled from scalar loads, the blend as in
+// blendRowsSse41 with per-lane weights
+DFC_SSE41 void scaleRowSse41(const uint8_t* src, int srcWidth, uint8_t* dst,
+                             const int32_t* index, const uint8_t* weight,
+                             int count, int bpp) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+    const __m128i pack = loadMask(kScalePack.m[bpp - 1]);
+    const __m128i nextPixel = _mm_cvtsi32_si128(8 * bpp);
+    int n = scaleVectorTaps(index, srcWidth, count, bpp);
+    int x = 0;
+    for (; x + 4 <= n; x += 4) {
+        const uint8_t* p[4];
+        for (int k = 0; k < 4; k++) {
+            p[k] = src + index[x + k] * bpp;
+        }
+        __m128i p0 = _mm_setr_epi32(static_cast<int>(load32(p[0])), static_cast<int>(load32(p[1])),
+                                    static_cast<int>(load32(p[2])), static_cast<int>(load32(p[3])));
+        __m128i p1 = bpp > 2
+            ? _mm_setr_epi32(static_cast<int>(load32(p[0] + bpp)), static_cast<int>(load32(p[1] + bpp)),
+                             static_cast<int>(load32(p[2] + bpp)), static_cast<int>(load32(p[3] + bpp)))
+            : _mm_srl_epi32(p0, nextPixel);
+
+        // weight[x + k] in every byte of lane k
+        __m128i w = _mm_shuffle_epi8(_mm_cvtsi32_si128(static_cast<int>(load32(weight + x))), spread);
+        __m128i wLo = _mm_unpacklo_epi8(w, zero);
+        __m128i wHi = _mm_unpackhi_epi8(w, zero);
+        __m128i lo = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p0, zero), _mm_sub_epi16(full, wLo)),
+                          _mm_mullo_epi16(_mm_unpacklo_epi8(p1, zero), wLo)), round);
+        __m128i hi = _mm_add_epi16(
+            _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p0, zero), _mm_sub_epi16(full, wHi)),
+                          _mm_mullo_epi16(_mm_unpackhi_epi8(p1, zero), wHi)), round);
+        __m128i out = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+
+        uint8_t packed[16];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed), _mm_shuffle_epi8(out, pack));
+        memcpy(dst + x * bpp, packed, 4 * bpp);
+    }
+    scaleTail(src, dst, index, weight, x, count, bpp);
+}
+
+// Unpack-based transposes; SSE2 level, shared by the AVX2 kernel set
+
+DFC_SSE41 void transposeBlock8Sse41(const uint8_t* src, int srcStride,
+                                    uint8_t* dst, int dstStride) {
+    __m128i r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i * srcStride));
+    }
+
+    // Interleave rows pairwise at 8, 16 then 32 bits: each result register
+    // ends up holding two complete columns
+    __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+    __m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+    __m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+    __m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+    __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+    __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+
+    __m128i cols[4] = {
+        _mm_unpacklo_epi32(b0, b2),
+        _mm_unpackhi_epi32(b0, b2),
+        _mm_unpacklo_epi32(b1, b3),
+        _mm_unpackhi_epi32(b1, b3),
+    };
+    for (int i = 0; i < 4; i++) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i * 2) * dstStride), cols[i]);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i * 2 + 1) * dstStride),
+                         _mm_unpackhi_epi64(cols[i], cols[i]));
+    }
+}
+
+DFC_SSE41 void transposeBlock16Sse41(const uint8_t* src, int srcStride,
+                                     uint8_t* dst, int dstStride) {
+    __m128i r[8];
+    for (int i = 0; i < 8; i++) {
+        r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * srcStride));
+    }
+
+    __m128i a[8];
+    for (int i = 0; i < 4; i++) {
+        a[i * 2] = _mm_unpacklo_epi16(r[i * 2], r[i * 2 + 1]);
+        a[i * 2 + 1] = _mm_unpackhi_epi16(r[i * 2], r[i * 2 + 1]);
+    }
+
+    __m128i b[8];
+    for (int i = 0; i < 2; i++) {
+        b[i * 4 + 0] = _mm_unpacklo_epi32(a[i * 4 + 0], a[i * 4 + 2]);
+        b[i * 4 + 1] = _mm_unpackhi_epi32(a[i * 4 + 0], a[i * 4 + 2]);
+        b[i * 4 + 2] = _mm_unpacklo_epi32(a[i * 4 + 1], a[i * 4 + 3]);
+        b[i * 4 + 3] = _mm_unpackhi_epi32(a[i * 4 + 1], a[i * 4 + 3]);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 2) * dstStride),
+                         _mm_unpacklo_epi64(b[i], b[i + 4]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i * 2 + 1) * dstStride),
+                         _mm_unpackhi_epi64(b[i], b[i + 4]));
+    }
+}
+
+DFC_SSE41 inline void transpose4x4x32Sse41(const uint8_t* src, int srcStride,
+                                           uint8_t* dst, int dstStride) {
+    __m128i r[4];
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * srcStride));
+    }
+
+    __m128i t0 = _mm_unpacklo_epi32(r[0], r[1]);
+    __m128i t1 = _mm_unpacklo_epi32(r[2], r[3]);
+    __m128i t2 = _mm_unpackhi_epi32(r[0], r[1]);
+    __m128i t3 = _mm_unpackhi_epi32(r[2], r[3]);
+
+    __m128i rows[4] = {
+        _mm_unpacklo_epi64(t0, t1),
+        _mm_unpackhi_epi64(t0, t1),
+        _mm_unpacklo_epi64(t2, t3),
+        _mm_unpackhi_epi64(t2, t3),
+    };
+    for (int i = 0; i < 4; i++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * dstStride), rows[i]);
+    }
+}
+
+DFC_SSE41 void transposeBlock32Sse41(const uint8_t* src, int srcStride,
+                                     uint8_t* dst, int dstStride) {
+    for (int y = 0; y < 8; y += 4) {
+        for (int x = 0; x < 8; x += 4) {
+            transpose4x4x32Sse41(src + y * srcStride + x * 4, srcStride,
+                                 dst + x * dstStride + y * 4, dstStride);
+        }
+    }
+}
+
+void transposeSse41(const uint8_t* src, int srcStride, uint8_t* dst, int dstStride,
+                    int width, int height, int bpp) {
+    TransposeBlock block = nullptr;
+    if (bpp == 1) block = transposeBlock8Sse41;
+    else if (bpp == 2) block = transposeBlock16Sse41;
+    else if (bpp == 4) block = transposeBlock32Sse41;
+    transposeTiled(src, srcStride, dst, dstStride, width, height, bpp, block);
+}
+
+const Kernels kSse41Kernels = {
+    Isa::Sse41,
+    rgbToNv21Sse41,
+    rgbToI420Sse41,
+    nv21ToRgbSse41,
+    blendRowsSse41,
+    scaleRowSse41,
+    transposeSse41,
+};
+
+// AVX2: the shuffles stay 128-bit (pshufb cannot cross lanes), the
+// arithmetic runs on 16 pixels per instruction.
+
+DFC_AVX2 inline __m256i lumaAvx2(__m256i r, __m256i g, __m256i b) {
+    __m256i acc = _mm256_mullo_epi16(r, _mm256_set1_epi16(66));
+    acc = _mm256_add_epi16(acc, _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+    acc = _mm256_add_epi16(acc, _mm256_mullo_epi16(b, _mm256_set1_epi16(25)));
+    acc = _mm256_srli_epi16(_mm256_add_epi16(acc, _mm256_set1_epi16(128)), 8);
+    return _mm256_add_epi16(acc, _mm256_set1_epi16(16));
+}
+
+DFC_AVX2 inline __m128i packus256(__m256i v) {
+    return _mm_packus_epi16(_mm256_castsi256_si128(v),
+                            _mm256_extracti128_si256(v, 1));
+}
+
+DFC_AVX2 inline __m128i luma16Avx2(__m128i r8, __m128i g8, __m128i b8) {
+    return packus256(lumaAvx2(_mm256_cvtepu8_epi16(r8), _mm256_cvtepu8_epi16(g8),
+                              _mm256_cvtepu8_epi16(b8)));
+}
+
+// U and V (16-bit lanes) for the 16 even pixels of two 16-pixel blocks
+DFC_AVX2 inline void chromaAvx2(const __m128i rgbA[3], const __m128i rgbB[3],
+                                __m256i& u, __m256i& v) {
+    const __m128i evenMask = _mm_set1_epi16(0x00FF);
+    const __m256i bias = _mm256_set1_epi16(128);
+    __m256i ch[3];
+    for (int c = 0; c < 3; c++) {
+        ch[c] = _mm256_set_m128i(_mm_and_si128(rgbB[c], evenMask),
+                                 _mm_and_si128(rgbA[c], evenMask));
+    }
+
+    u = _mm256_mullo_epi16(ch[2], _mm256_set1_epi16(112));
+    u = _mm256_sub_epi16(u, _mm256_mullo_epi16(ch[0], _mm256_set1_epi16(38)));
+    u = _mm256_sub_epi16(u, _mm256_mullo_epi16(ch[1], _mm256_set1_epi16(74)));
+    u = _mm256_add_epi16(_mm256_srai_epi16(_mm256_add_epi16(u, bias), 8), bias);
+
+    v = _mm256_mullo_epi16(ch[0], _mm256_set1_epi16(112));
+    v = _mm256_sub_epi16(v, _mm256_mullo_epi16(ch[1], _mm256_set1_epi16(94)));
+    v = _mm256_sub_epi16(v, _mm256_mullo_epi16(ch[2], _mm256_set1_epi16(18)));
+    v = _mm256_add_epi16(_mm256_srai_epi16(_mm256_add_epi16(v, bias), 8), bias);
+}
+
+DFC_AVX2 void rgbToNv21Avx2(const uint8_t* rgb, int rgbStride,
+                            uint8_t* yPlane, int yStride,
+                            uint8_t* vuPlane, int vuStride,
+                            int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        uint8_t* yRow = yPlane + j * yStride;
+        uint8_t* vu = ((j & 1) == 0) ? vuPlane + (j / 2) * vuStride : nullptr;
+
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m128i a[3], b[3];
+            deinterleaveRgb(src + x * 3, a[0], a[1], a[2]);
+            deinterleaveRgb(src + x * 3 + 48, b[0], b[1], b[2]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(yRow + x),
+                             luma16Avx2(a[0], a[1], a[2]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(yRow + x + 16),
+                             luma16Avx2(b[0], b[1], b[2]));
+
+            if (vu) {
+                __m256i u, v;
+                chromaAvx2(a, b, u, v);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(vu + x),
+                                    _mm256_or_si256(v, _mm256_slli_epi16(u, 8)));
+            }
+        }
+        if (x + 16 <= width) {
+            rgbToNv21Block(src, yRow, vu, x);
+            x += 16;
+        }
+
+        lumaRow(src, yRow, x, width);
+        if (vu) {
+            vuRow(src, vu, x, width);
+        }
+    }
+}
+
+DFC_AVX2 void rgbToI420Avx2(const uint8_t* rgb, int rgbStride,
+                            uint8_t* yPlane, int yStride,
+                            uint8_t* uPlane, int uStride,
+                            uint8_t* vPlane, int vStride,
+                            int width, int height) {
+    for (int j = 0; j < height; j++) {
+        const uint8_t* src = rgb + j * rgbStride;
+        uint8_t* yRow = yPlane + j * yStride;
+        bool chromaRow = (j & 1) == 0;
+        uint8_t* uRow = uPlane + (j / 2) * uStride;
+        uint8_t* vRow = vPlane + (j / 2) * vStride;
+
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m128i a[3], b[3];
+            deinterleaveRgb(src + x * 3, a[0], a[1], a[2]);
+            deinterleaveRgb(src + x * 3 + 48, b[0], b[1], b[2]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(yRow + x),
+                             luma16Avx2(a[0], a[1], a[2]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(yRow + x + 16),
+                             luma16Avx2(b[0], b[1], b[2]));
+
+            if (chromaRow) {
+                __m256i u, v;
+                chromaAvx2(a, b, u, v);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(uRow + x / 2),
+                                 packus256(u));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(vRow + x / 2),
+                                 packus256(v));
+            }
+        }
+        if (x + 16 <= width) {
+            rgbToI420Block(src, yRow, chromaRow ? uRow : nullptr, vRow, x);
+            x += 16;
+        }
+
+        lumaRow(src, yRow, x, width);
+        if (chromaRow) {
+            uvRow(src, uRow, vRow, x, width);
+        }
+    }
+}
+
+DFC_AVX2 inline __m256i pairConst256(int a, int b) {
+    return _mm256_set1_epi32(static_cast<int32_t>(
+        (static_cast<uint32_t>(static_cast<uint16_t>(b)) << 16) |
+        static_cast<uint16_t>(a)));
+}
+
+// (madd(lo) + add) >> 8 and (madd(hi) + add) >> 8, packed back to 16 lanes
+// in pixel order (unpacklo/hi and packs are both per 128-bit lane)
+DFC_AVX2 inline __m256i maddShift(__m256i lo, __m256i hi, __m256i k,
+                                  __m256i addLo, __m256i addHi) {
+    return _mm256_packs_epi32(
+        _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, k), addLo), 8),
+        _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, k), addHi), 8));
+}
+
+DFC_AVX2 void nv21ToRgbAvx2(const uint8_t* yPlane, int yStride,
+                            const uint8_t* vuPlane, int vuStride,
+                            uint8_t* rgb, int rgbStride,
+                            int width, int height) {
+    const __m128i evenMask = _mm_set1_epi16(0x00FF);
+    const __m128i chromaBias = _mm_set1_epi16(128);
+    const __m256i lumaBias = _mm256_set1_epi16(16);
+    const __m256i round = _mm256_set1_epi32(128);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i kR = pairConst256(298, 409);
+    const __m256i kG0 = pairConst256(298, -100);
+    const __m256i kG1 = pairConst256(-208, 128);
+    const __m256i kB = pairConst256(298, 516);
+
+    for (int j = 0; j < height; j++) {
+        const uint8_t* yRow = yPlane + j * yStride;
+        const uint8_t* vu = vuPlane + (j / 2) * vuStride;
+        uint8_t* dst = rgb + j * rgbStride;
+
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(yRow + x));
+            __m128i vu8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vu + x));
+
+            __m128i v8 = _mm_sub_epi16(_mm_and_si128(vu8, evenMask), chromaBias);
+            __m128i u8 = _mm_sub_epi16(_mm_srli_epi16(vu8, 8), chromaBias);
+            __m256i v = _mm256_set_m128i(_mm_unpackhi_epi16(v8, v8),
+                                         _mm_unpacklo_epi16(v8, v8));
+            __m256i u = _mm256_set_m128i(_mm_unpackhi_epi16(u8, u8),
+                                         _mm_unpacklo_epi16(u8, u8));
+            __m256i c = _mm256_sub_epi16(_mm256_cvtepu8_epi16(y8), lumaBias);
+
+            __m256i cvLo = _mm256_unpacklo_epi16(c, v), cvHi = _mm256_unpackhi_epi16(c, v);
+            __m256i cuLo = _mm256_unpacklo_epi16(c, u), cuHi = _mm256_unpackhi_epi16(c, u);
+            __m256i v1Lo = _mm256_unpacklo_epi16(v, one), v1Hi = _mm256_unpackhi_epi16(v, one);
+
+            __m256i r = maddShift(cvLo, cvHi, kR, round, round);
+            __m256i g = maddShift(cuLo, cuHi, kG0,
+                                  _mm256_madd_epi16(v1Lo, kG1),
+                                  _mm256_madd_epi16(v1Hi, kG1));
+            __m256i b = maddShift(cuLo, cuHi, kB, round, round);
+
+            interleaveRgb(dst + x * 3, packus256(r), packus256(g), packus256(b));
+        }
+
+        nv21Row(yRow, vu, dst, x, width);
+    }
+}
+
+DFC_AVX2 void blendRowsAvx2(const uint8_t* a, const uint8_t* b, uint8_t* dst,
+                            int count, int weight) {
+    const __m256i wa = _mm256_set1_epi16(static_cast<int16_t>(256 - weight));
+    const __m256i wb = _mm256_set1_epi16(static_cast<int16_t>(weight));
+    const __m256i round = _mm256_set1_epi16(128);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i acc = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(va, wa), _mm256_mullo_epi16(vb, wb)), round);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         packus256(_mm256_srli_epi16(acc, 8)));
+    }
+    blendTail(a, b, dst, i, count, weight);
+}
+
+// Eight taps per iteration, each lane filled by a gather
+DFC_AVX2 void scaleRowAvx2(const uint8_t* src, int srcWidth, uint8_t* dst,
+                           const int32_t* index, const uint8_t* weight,
+                           int count, int bpp) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i full = _mm256_set1_epi16(256);
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i spread = _mm256_set1_epi32(0x01010101);
+    const __m256i stride = _mm256_set1_epi32(bpp);
+    const __m128i nextPixel = _mm_cvtsi32_si128(8 * bpp);
+    const __m256i pack = _mm256_broadcastsi128_si256(loadMask(kScalePack.m[bpp - 1]));
+    // After the per-lane pack, move the bpp packed dwords of the upper
+    // 128-bit lane up against those of the lower one
+    int32_t lanes[8];
+    for (int i = 0; i < 8; i++) {
+        lanes[i] = (i < bpp ? i : i + 4 - bpp) & 7;
+    }
+    const __m256i order = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+    const int* base = reinterpret_cast<const int*>(src);
+    const int* next = reinterpret_cast<const int*>(src + bpp);
+    int n = scaleVectorTaps(index, srcWidth, count, bpp);
+    int x = 0;
+    for (; x + 8 <= n; x += 8) {
+        __m256i offset = _mm256_mullo_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index + x)), stride);
+        __m256i p0 = _mm256_i32gather_epi32(base, offset, 1);
+        __m256i p1 = bpp > 2 ? _mm256_i32gather_epi32(next, offset, 1)
+                             : _mm256_srl_epi32(p0, nextPixel);
+
+        // weight[x + k] in every byte of lane k
+        __m256i w = _mm256_mullo_epi32(
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weight + x))),
+            spread);
+        __m256i wLo = _mm256_unpacklo_epi8(w, zero);
+        __m256i wHi = _mm256_unpackhi_epi8(w, zero);
+        __m256i lo = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(p0, zero), _mm256_sub_epi16(full, wLo)),
+                             _mm256_mullo_epi16(_mm256_unpacklo_epi8(p1, zero), wLo)), round);
+        __m256i hi = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(p0, zero), _mm256_sub_epi16(full, wHi)),
+                             _mm256_mullo_epi16(_mm256_unpackhi_epi8(p1, zero), wHi)), round);
+        __m256i out = _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+
+        uint8_t packed[32];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(packed),
+                            _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(out, pack), order));
+        memcpy(dst + x * bpp, packed, 8 * bpp);
+    }
+    scaleTail(src, dst, index, weight, x, count, bpp);
+}
+
+const Kernels kAvx2Kernels = {
+    Isa::Avx2,
+    rgbToNv21Avx2,
+    rgbToI420Avx2,
+    nv21ToRgbAvx2,
+    blendRowsAvx2,
+    scaleRowAvx2,
+    transposeSse41,
+};
+
+#endif // DFC_HAVE_X86
+
+Isa detectIsa() {
+#if defined(DFC_HAVE_NEON)
+#if defined(__aarch64__)
+    return Isa::Neon;
+#else
+    return (getauxval(AT_HWCAP) & kHwcapNeon) ? Isa::Neon : Isa::Scalar;
+#endif
+#elif defined(DFC_HAVE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Isa::Avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return Isa::Sse41;
+    }
+    return Isa::Scalar;
+#else
+    return Isa::Scalar;
+#endif
+}
+
+const Kernels& kernelsFor(Isa isa) {
+    switch (isa) {
+#if defined(DFC_HAVE_NEON)
+    case Isa::Neon:
+        return kNeonKernels;
+#endif
+#if defined(DFC_HAVE_X86)
+    case Isa::Sse41:
+        return kSse41Kernels;
+    case Isa::Avx2:
+        return kAvx2Kernels;
+#endif
+    default:
+        return kScalarKernels;
+    }
+}
+
+const Kernels& selectKernels() {
+    const Kernels& kernels = kernelsFor(detectIsa());
+    LOGI("Frame kernels: %s", isaName(kernels.isa));
+    return kernels;
+}
+
+} // namespace
+
+const Kernels& best() {
+    // Thread-safe one-time selection
+    static const Kernels& kernels = selectKernels();
+    return kernels;
+}
+
+const Kernels& scalar() {
+    return kScalarKernels;
+}
+
+const Kernels* forIsa(Isa isa) {
+    if (isa == Isa::Scalar) {
+        return &kScalarKernels;
+    }
+
+    // Anything up to the detected level is usable
+    Isa detected = best().isa;
+    const Kernels& kernels = kernelsFor(isa);
+    if (kernels.isa != isa) {
+        return nullptr;  // Not compiled for this ABI
+    }
+    if (isa == Isa::Avx2 && detected != Isa::Avx2) {
+        return nullptr;
+    }
+    if (detected == Isa::Scalar) {
+        return nullptr;
+    }
+    return &kernels;
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+    case Isa::Neon:
+        return "NEON";
+    case Isa::Sse41:
+        return "SSE4.1";
+    case Isa::Avx2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+} // namespace FrameSimd
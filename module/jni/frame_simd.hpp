@@ -0,0 +1,82 @@
+/*
+ * DroidFakeCam - SIMD Kernels Header
+ *
+ * Per-ISA implementations of the per-pixel loops behind FrameUtils.
+ * The best kernel set for the running CPU is picked once, at first use:
+ * NEON on ARM, AVX2 or SSE4.1 on x86, plain C everywhere else. All
+ * variants produce bit-identical output.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace FrameSimd {
+
+enum class Isa {
+    Scalar,
+    Neon,
+    Sse41,
+    Avx2,
+};
+
+struct Kernels {
+    Isa isa;
+
+    // RGB24 -> NV21 (Y plane + interleaved VU plane). Chroma is taken from
+    // the top-left pixel of each 2x2 block. Width and height must be even.
+    void (*rgbToNv21)(const uint8_t* rgb, int rgbStride,
+                      uint8_t* yPlane, int yStride,
+                      uint8_t* vuPlane, int vuStride,
+                      int width, int height);
+
+    // RGB24 -> I420 (Y, U, V planes), same sampling as rgbToNv21
+    void (*rgbToI420)(const uint8_t* rgb, int rgbStride,
+                      uint8_t* yPlane, int yStride,
+                      uint8_t* uPlane, int uStride,
+                      uint8_t* vPlane, int vStride,
+                      int width, int height);
+
+    // NV21 -> RGB24
+    void (*nv21ToRgb)(const uint8_t* yPlane, int yStride,
+                      const uint8_t* vuPlane, int vuStride,
+                      uint8_t* rgb, int rgbStride,
+                      int width, int height);
+
+    // dst[i] = (a[i] * (256 - weight) + b[i] * weight + 128) >> 8, the
+    // vertical step of the bilinear scaler. weight is Q8 in 1..255.
+    void (*blendRows)(const uint8_t* a, const uint8_t* b, uint8_t* dst,
+                      int count, int weight);
+
+    // The horizontal step: `count` pixels of `bpp`-byte samples (1..4),
+    // pixel x blending source pixels index[x] and index[x] + 1 as above
+    // with weight[x] (Q8, 0..255). weight[x] must be 0 where index[x] is
+    // the last of the `srcWidth` source pixels, and index must not
+    // decrease. Vector variants fetch each pixel pair with 4-byte loads
+    // (AVX2 gathers); taps near the row end go through the scalar loop.
+    void (*scaleRow)(const uint8_t* src, int srcWidth, uint8_t* dst,
+                     const int32_t* index, const uint8_t* weight,
+                     int count, int bpp);
+
+    // Transpose a width x height plane of `bpp`-byte samples (1..4):
+    // dst row x, column y = src row y, column x. Strides may be negative,
+    // which turns the transpose into a 90 degree rotation.
+    void (*transpose)(const uint8_t* src, int srcStride,
+                      uint8_t* dst, int dstStride,
+                      int width, int height, int bpp);
+};
+
+// Kernels for the running CPU
+const Kernels& best();
+
+// Portable reference kernels
+const Kernels& scalar();
+
+// Kernels for a specific ISA, or nullptr if this build or CPU lacks it
+const Kernels* forIsa(Isa isa);
+
+const char* isaName(Isa isa);
+
+} // namespace FrameSimd
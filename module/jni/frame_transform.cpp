@@ -0,0 +1,312 @@
+/*
+ * DroidFakeCam - Frame Transform Implementation
+ *
+ * Each plane is scaled in the source orientation through FrameScaler (row
+ * cache, SIMD blend), then put in place: quarter turns through the tiled
+ * transpose behind rotatePlane90 (mirror included), half turns and
+ * mirrors by writing rows bottom-up and reversing them in place. Format
+ * conversion, when asked for, runs last on the target-sized frame, in
+ * two-row bands through the FrameSimd kernels.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "frame_transform.hpp"
+#include "frame_scaler.hpp"
+#include "frame_simd.hpp"
+#include "pipeline_stats.hpp"
+#include <android/log.h>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+namespace FrameTransform {
+
+namespace {
+
+using FrameUtils::Plane;
+using FrameUtils::PlaneLayout;
+using PlanPtr = std::shared_ptr<const FrameScaler::Plan>;
+
+// Where the U and V samples of a YUV format live: plane index and byte
+// offset within a sample
+struct Channel {
+    int plane;
+    int offset;
+};
+
+void getChromaChannels(int format, Channel& u, Channel& v) {
+    if (format == FORMAT_NV21) {
+        u = {1, 1};
+        v = {1, 0};
+    } else if (format == FORMAT_NV12) {
+        u = {1, 0};
+        v = {1, 1};
+    } else {
+        u = {1, 0};
+        v = {2, 0};
+    }
+}
+
+uint8_t* planeRow(FrameData& frame, const Plane& p, int y, int channel = 0) {
+    return frame.data + p.offset + static_cast<ptrdiff_t>(y) * p.stride + channel;
+}
+
+const uint8_t* planeRow(const uint8_t* base, const Plane& p, int y, int channel = 0) {
+    return base + p.offset + static_cast<ptrdiff_t>(y) * p.stride + channel;
+}
+
+// Scale each plane of `src` into the matching plane of `out` (same format,
+// target size) and apply `orientation`
+void orientPlanes(const FrameData& src, const PlaneLayout& srcLayout,
+                  FrameData& out, const PlaneLayout& outLayout,
+                  Orientation orientation) {
+    int rotation = orientation.rotation;
+    FrameData scratch;
+    for (int i = 0; i < srcLayout.count; i++) {
+        const Plane& sp = srcLayout.planes[i];
+        const Plane& dp = outLayout.planes[i];
+        const uint8_t* in = src.data + sp.offset;
+
+        if (rotation == 90 || rotation == 270) {
+            // Scale to the destination plane's size turned back, then turn
+            const uint8_t* turnBase = src.data;
+            Plane turn = sp;
+            if (sp.width != dp.height || sp.height != dp.width) {
+                turn.offset = 0;
+                turn.width = dp.height;
+                turn.height = dp.width;
+                turn.stride = turn.width * sp.bpp;
+                uint8_t* scaled = scratch.allocate(static_cast<size_t>(turn.stride) * turn.height);
+                PlanPtr plan = FrameScaler::getPlan(sp.width, sp.height, turn.width, turn.height);
+                FrameScaler::scalePlane(*plan, sp.bpp, in, sp.stride, scaled, turn.stride);
+                turnBase = scaled;
+            }
+            FrameUtils::rotatePlane90(turnBase, turn, out.data, dp, rotation == 90,
+                                      orientation.mirror);
+            continue;
+        }
+
+        // A half turn is a vertical flip plus a mirror, so a mirrored half
+        // turn is the vertical flip alone: rows written bottom-up
+        uint8_t* row0 = planeRow(out, dp, 0);
+        int stride = dp.stride;
+        if (rotation == 180) {
+            row0 = planeRow(out, dp, dp.height - 1);
+            stride = -stride;
+        }
+        PlanPtr plan = FrameScaler::getPlan(sp.width, sp.height, dp.width, dp.height);
+        FrameScaler::scalePlane(*plan, sp.bpp, in, sp.stride, row0, stride);
+        if ((rotation == 180) != orientation.mirror) {
+            FrameUtils::flipPlane(out.data, dp);
+        }
+    }
+}
+
+// YUV -> YUV of another layout: luma rows copied, chroma samples moved
+// one at a time so any of NV21/NV12/YUV420 can feed any other
+void convertYuv(const uint8_t* base, const PlaneLayout& in, FrameFormat inFormat,
+                FrameData& dst, const PlaneLayout& out) {
+    const Plane& inY = in.planes[0];
+    const Plane& outY = out.planes[0];
+    for (int y = 0; y < dst.height; y++) {
+        memcpy(planeRow(dst, outY, y), planeRow(base, inY, y), dst.width);
+    }
+
+    Channel inU, inV, outU, outV;
+    getChromaChannels(inFormat, inU, inV);
+    getChromaChannels(dst.format, outU, outV);
+    const Plane& uIn = in.planes[inU.plane];
+    const Plane& vIn = in.planes[inV.plane];
+    const Plane& uOut = out.planes[outU.plane];
+    const Plane& vOut = out.planes[outV.plane];
+    for (int y = 0; y < dst.height / 2; y++) {
+        const uint8_t* su = planeRow(base, uIn, y, inU.offset);
+        const uint8_t* sv = planeRow(base, vIn, y, inV.offset);
+        uint8_t* du = planeRow(dst, uOut, y, outU.offset);
+        uint8_t* dv = planeRow(dst, vOut, y, outV.offset);
+        for (int x = 0; x < dst.width / 2; x++) {
+            du[x * uOut.bpp] = su[x * uIn.bpp];
+            dv[x * vOut.bpp] = sv[x * vIn.bpp];
+        }
+    }
+}
+
+// YUV -> RGB through the NV21 kernel; other layouts have their chroma
+// interleaved into one VU row per band first
+void convertYuvToRgb(const uint8_t* base, const PlaneLayout& in, FrameFormat inFormat,
+                     FrameData& dst) {
+    const FrameSimd::Kernels& kernels = FrameSimd::best();
+    const Plane& yPlane = in.planes[0];
+    int width = dst.width;
+    if (inFormat == FORMAT_NV21) {
+        kernels.nv21ToRgb(planeRow(base, yPlane, 0), yPlane.stride,
+                          planeRow(base, in.planes[1], 0), in.planes[1].stride,
+                          dst.data, dst.stride, width, dst.height);
+        return;
+    }
+
+    Channel u, v;
+    getChromaChannels(inFormat, u, v);
+    const Plane& uPlane = in.planes[u.plane];
+    const Plane& vPlane = in.planes[v.plane];
+    FrameData scratch;
+    uint8_t* vuRow = scratch.allocate(width);
+    for (int band = 0; band < dst.height / 2; band++) {
+        const uint8_t* su = planeRow(base, uPlane, band, u.offset);
+        const uint8_t* sv = planeRow(base, vPlane, band, v.offset);
+        for (int x = 0; x < width / 2; x++) {
+            vuRow[x * 2] = sv[x * vPlane.bpp];
+            vuRow[x * 2 + 1] = su[x * uPlane.bpp];
+        }
+        kernels.nv21ToRgb(planeRow(base, yPlane, band * 2), yPlane.stride, vuRow, 0,
+                          dst.data + static_cast<size_t>(band) * 2 * dst.stride,
+                          dst.stride, width, 2);
+    }
+}
+
+// RGBA row -> RGB row
+void dropAlpha(const uint8_t* rgba, uint8_t* rgb, int width) {
+    for (int x = 0; x < width; x++) {
+        rgb[x * 3] = rgba[x * 4];
+        rgb[x * 3 + 1] = rgba[x * 4 + 1];
+        rgb[x * 3 + 2] = rgba[x * 4 + 2];
+    }
+}
+
+// RGB/RGBA -> YUV, two rows at a time (RGBA rows staged as RGB)
+void convertRgbToYuv(const uint8_t* base, const PlaneLayout& in, FrameFormat inFormat,
+                     FrameData& dst, const PlaneLayout& out) {
+    int width = dst.width;
+    int rgbStride = width * 3;
+    FrameData scratch;
+    uint8_t* rgbRows = scratch.allocate(static_cast<size_t>(rgbStride) * 2 + width);
+    uint8_t* uRow = rgbRows + rgbStride * 2;
+    uint8_t* vRow = uRow + width / 2;
+
+    const FrameSimd::Kernels& kernels = FrameSimd::best();
+    const Plane& rgbPlane = in.planes[0];
+    const Plane& yPlane = out.planes[0];
+    for (int band = 0; band < dst.height / 2; band++) {
+        const uint8_t* rgb = planeRow(base, rgbPlane, band * 2);
+        int stride = rgbPlane.stride;
+        if (inFormat == FORMAT_RGBA) {
+            dropAlpha(rgb, rgbRows, width);
+            dropAlpha(rgb + rgbPlane.stride, rgbRows + rgbStride, width);
+            rgb = rgbRows;
+            stride = rgbStride;
+        }
+
+        uint8_t* yRow = planeRow(dst, yPlane, band * 2);
+        if (dst.format == FORMAT_NV21) {
+            kernels.rgbToNv21(rgb, stride, yRow, yPlane.stride,
+                              planeRow(dst, out.planes[1], band), 0, width, 2);
+        } else if (dst.format == FORMAT_YUV420) {
+            kernels.rgbToI420(rgb, stride, yRow, yPlane.stride,
+                              planeRow(dst, out.planes[1], band), 0,
+                              planeRow(dst, out.planes[2], band), 0, width, 2);
+        } else {
+            // NV12: no interleaved-UV kernel, so split then interleave
+            kernels.rgbToI420(rgb, stride, yRow, yPlane.stride,
+                              uRow, 0, vRow, 0, width, 2);
+            uint8_t* uv = planeRow(dst, out.planes[1], band);
+            for (int x = 0; x < width / 2; x++) {
+                uv[x * 2] = uRow[x];
+                uv[x * 2 + 1] = vRow[x];
+            }
+        }
+    }
+}
+
+// Convert the planes `in` (relative to `base`, format `inFormat`) into
+// `dst`, which has the same size
+void convertPlanes(const uint8_t* base, const PlaneLayout& in, FrameFormat inFormat,
+                   FrameData& dst, const PlaneLayout& out) {
+    bool inYuv = FrameUtils::isYuv(inFormat);
+    bool outYuv = FrameUtils::isYuv(dst.format);
+    if (inYuv && outYuv) {
+        convertYuv(base, in, inFormat, dst, out);
+    } else if (inYuv) {
+        convertYuvToRgb(base, in, inFormat, dst);
+    } else if (outYuv) {
+        convertRgbToYuv(base, in, inFormat, dst, out);
+    } else {
+        // RGBA -> RGB
+        const Plane& p = in.planes[0];
+        for (int y = 0; y < dst.height; y++) {
+            dropAlpha(planeRow(base, p, y), planeRow(dst, out.planes[0], y), dst.width);
+        }
+    }
+}
+
+} // namespace
+
+bool apply(const FrameData& src, FrameData& dst,
+           FrameFormat targetFormat, int targetWidth, int targetHeight,
+           Orientation orientation) {
+    PipelineStats::ScopedTimer timer(PipelineStats::STAGE_TRANSFORM);
+
+    int rotation = orientation.rotation;
+    if (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270) {
+        LOGE("FrameTransform: Invalid rotation %d", rotation);
+        return false;
+    }
+
+    PlaneLayout srcLayout;
+    if (!src.data || !FrameUtils::getFrameLayout(src, srcLayout)) {
+        LOGE("FrameTransform: Unsupported source frame (format %d, %dx%d)",
+             src.format, src.width, src.height);
+        return false;
+    }
+
+    bool srcYuv = FrameUtils::isYuv(src.format);
+    bool dstYuv = FrameUtils::isYuv(targetFormat);
+    bool supported = dstYuv || targetFormat == FORMAT_RGB ||
+                     (targetFormat == FORMAT_RGBA && src.format == FORMAT_RGBA);
+
+    // YUV -> RGB works on 2x2 chroma blocks
+    if (srcYuv && !dstYuv && (targetWidth % 2 != 0 || targetHeight % 2 != 0)) {
+        supported = false;
+    }
+
+    PlaneLayout dstLayout;
+    if (!supported ||
+        !FrameUtils::prepareFrame(dst, targetFormat, targetWidth, targetHeight, dstLayout)) {
+        LOGE("FrameTransform: Unsupported transform %d %dx%d -> %d %dx%d",
+             src.format, src.width, src.height,
+             targetFormat, targetWidth, targetHeight);
+        return false;
+    }
+
+    bool reoriented = rotation != 0 || orientation.mirror;
+    if (!reoriented && src.width == targetWidth && src.height == targetHeight &&
+        src.format != targetFormat) {
+        // Conversion only (e.g. padded decoder output): no staging frame
+        convertPlanes(src.data, srcLayout, src.format, dst, dstLayout);
+    } else if (src.format == targetFormat) {
+        orientPlanes(src, srcLayout, dst, dstLayout, orientation);
+    } else {
+        // Scale and orient at the target size first, then convert
+        FrameData staged;
+        PlaneLayout stagedLayout;
+        if (!FrameUtils::prepareFrame(staged, src.format, targetWidth, targetHeight,
+                                      stagedLayout)) {
+            LOGE("FrameTransform: Cannot stage %dx%d frame of format %d",
+                 targetWidth, targetHeight, src.format);
+            return false;
+        }
+        orientPlanes(src, srcLayout, staged, stagedLayout, orientation);
+        convertPlanes(staged.data, stagedLayout, src.format, dst, dstLayout);
+    }
+
+    LOGD("Transformed frame %dx%d -> %dx%d (rotation %d%s, format %d -> %d)",
+         src.width, src.height, targetWidth, targetHeight, rotation,
+         orientation.mirror ? ", mirrored" : "", src.format, targetFormat);
+    return true;
+}
+
+} // namespace FrameTransform
@@ -0,0 +1,38 @@
+/*
+ * DroidFakeCam - Frame Transform Header
+ *
+ * Orientation + scale + format conversion in one call. The result is
+ * that of scaleFrame, flipHorizontal, rotate90CW/rotate180 and
+ * convertFormat chained, without the full-frame intermediates: scaling
+ * feeds the tiled rotation from a scratch plane, mirrors and half turns
+ * need no intermediate at all, and conversion only stages the
+ * target-sized frame.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_utils.hpp"
+
+namespace FrameTransform {
+
+// Geometry applied to the source: optional horizontal mirror first, then
+// a clockwise rotation. The front camera preview is {90, true}.
+struct Orientation {
+    int rotation;  // 0, 90, 180 or 270
+    bool mirror;
+};
+
+// Scale `src` (bilinear, in its own orientation) to fit
+// targetWidth x targetHeight once `orientation` is applied, and write it
+// as a frame of `targetFormat`.
+//
+// Supported: any of NV21/NV12/YUV420 to any of NV21/NV12/YUV420/RGB;
+// RGB/RGBA to RGB or any YUV format; RGBA to RGBA. YUV sources and
+// targets need even dimensions.
+bool apply(const FrameData& src, FrameData& dst,
+           FrameFormat targetFormat, int targetWidth, int targetHeight,
+           Orientation orientation);
+
+} // namespace FrameTransform
@@ -8,6 +8,10 @@
  */
 
 #include "frame_utils.hpp"
+#include "frame_scaler.hpp"
+#include "frame_simd.hpp"
+#include "frame_transform.hpp"
+#include "pipeline_stats.hpp"
 #include <android/log.h>
 #include <algorithm>
 #include <cstring>
@@ -19,85 +23,420 @@
 
 namespace FrameUtils {
 
-// Clamp value to byte range
-inline uint8_t clamp(int val) {
-    return static_cast<uint8_t>(std::max(0, std::min(255, val)));
+bool isYuv(FrameFormat format) {
+    return format == FORMAT_NV21 || format == FORMAT_NV12 ||
+           format == FORMAT_YUV420;
 }
 
-bool scaleFrame(const FrameData& src, FrameData& dst, 
-                int targetWidth, int targetHeight) {
-    if (!src.data || src.size == 0) {
-        LOGE("scaleFrame: Invalid source frame");
+bool getPlaneLayout(FrameFormat format, int width, int height, int stride,
+                    PlaneLayout& layout) {
+    if (width <= 0 || height <= 0) {
         return false;
     }
     
-    if (src.format != 2 && src.format != 3) {
-        LOGE("scaleFrame: Only RGB/RGBA formats supported for scaling");
+    if (format == FORMAT_RGB || format == FORMAT_RGBA) {
+        int bpp = (format == FORMAT_RGBA) ? 4 : 3;
+        layout.count = 1;
+        layout.planes[0] = {0, std::max(stride, width * bpp), width, height, bpp};
+        return true;
+    }
+    
+    if (!isYuv(format) || width % 2 != 0 || height % 2 != 0) {
         return false;
     }
     
-    int bpp = (src.format == 2) ? 4 : 3; // bytes per pixel
+    int yStride = std::max(stride, width);
+    ptrdiff_t ySize = static_cast<ptrdiff_t>(yStride) * height;
+    layout.planes[0] = {0, yStride, width, height, 1};
     
-    dst.width = targetWidth;
-    dst.height = targetHeight;
-    dst.format = src.format;
-    dst.stride = targetWidth * bpp;
-    dst.size = dst.stride * targetHeight;
-    dst.data = new uint8_t[dst.size];
+    if (format == FORMAT_YUV420) {
+        // I420: U plane then V plane at half the luma pitch
+        int cStride = yStride / 2;
+        ptrdiff_t cSize = static_cast<ptrdiff_t>(cStride) * (height / 2);
+        layout.count = 3;
+        layout.planes[1] = {ySize, cStride, width / 2, height / 2, 1};
+        layout.planes[2] = {ySize + cSize, cStride, width / 2, height / 2, 1};
+    } else {
+        // NV21/NV12: one interleaved chroma plane; flipping, rotating and
+        // scaling it as 2-byte samples keeps each VU (UV) pair together
+        layout.count = 2;
+        layout.planes[1] = {ySize, yStride, width / 2, height / 2, 2};
+    }
+    return true;
+}
+
+size_t getLayoutSize(const PlaneLayout& layout) {
+    const Plane& last = layout.planes[layout.count - 1];
+    return static_cast<size_t>(last.offset) + static_cast<size_t>(last.stride) * (last.height - 1) +
+           static_cast<size_t>(last.width) * last.bpp;
+}
+
+namespace {
+
+// Does an external plane cover width x height samples of `bpp` bytes?
+bool planeCovers(const FramePlane& p, int width, int height, int bpp = 1) {
+    return p.data && p.rowStride > 0 && p.pixelStride > 0 &&
+           static_cast<size_t>(p.rowStride) * (height - 1) +
+           static_cast<size_t>(width - 1) * p.pixelStride + bpp <= p.length;
+}
+
+// Layout of a frame described by external planes (FrameData::planes)
+bool getWrappedLayout(const FrameData& frame, PlaneLayout& layout) {
+    const FramePlane* fp = frame.planes;
+    int width = frame.width;
+    int height = frame.height;
+    
+    if (frame.format == FORMAT_RGB || frame.format == FORMAT_RGBA) {
+        int bpp = (frame.format == FORMAT_RGBA) ? 4 : 3;
+        if (frame.planeCount != 1 || fp[0].pixelStride != bpp ||
+            !planeCovers(fp[0], width, height, bpp)) {
+            return false;
+        }
+        layout.count = 1;
+        layout.planes[0] = {fp[0].data - frame.data, fp[0].rowStride, width, height, bpp};
+        return true;
+    }
     
-    // Bilinear interpolation scaling
-    float xRatio = static_cast<float>(src.width) / targetWidth;
-    float yRatio = static_cast<float>(src.height) / targetHeight;
+    if (!isYuv(frame.format) || frame.planeCount != 3 ||
+        width % 2 != 0 || height % 2 != 0) {
+        return false;
+    }
     
-    for (int y = 0; y < targetHeight; y++) {
-        float srcY = y * yRatio;
-        int srcY0 = static_cast<int>(srcY);
-        int srcY1 = std::min(srcY0 + 1, src.height - 1);
-        float yFrac = srcY - srcY0;
-        
-        for (int x = 0; x < targetWidth; x++) {
-            float srcX = x * xRatio;
-            int srcX0 = static_cast<int>(srcX);
-            int srcX1 = std::min(srcX0 + 1, src.width - 1);
-            float xFrac = srcX - srcX0;
-            
-            int dstIdx = (y * targetWidth + x) * bpp;
-            
-            for (int c = 0; c < bpp; c++) {
-                int srcIdx00 = (srcY0 * src.width + srcX0) * bpp + c;
-                int srcIdx01 = (srcY0 * src.width + srcX1) * bpp + c;
-                int srcIdx10 = (srcY1 * src.width + srcX0) * bpp + c;
-                int srcIdx11 = (srcY1 * src.width + srcX1) * bpp + c;
-                
-                float val = src.data[srcIdx00] * (1 - xFrac) * (1 - yFrac) +
-                           src.data[srcIdx01] * xFrac * (1 - yFrac) +
-                           src.data[srcIdx10] * (1 - xFrac) * yFrac +
-                           src.data[srcIdx11] * xFrac * yFrac;
-                
-                dst.data[dstIdx + c] = clamp(static_cast<int>(val));
+    const FramePlane& y = fp[0];
+    const FramePlane& u = fp[1];
+    const FramePlane& v = fp[2];
+    int cw = width / 2;
+    int ch = height / 2;
+    if (y.pixelStride != 1 || !planeCovers(y, width, height) ||
+        !planeCovers(u, cw, ch) || !planeCovers(v, cw, ch)) {
+        return false;
+    }
+    layout.planes[0] = {y.data - frame.data, y.rowStride, width, height, 1};
+    
+    if (frame.format == FORMAT_YUV420) {
+        if (u.pixelStride != 1 || v.pixelStride != 1) {
+            return false;
+        }
+        layout.count = 3;
+        layout.planes[1] = {u.data - frame.data, u.rowStride, cw, ch, 1};
+        layout.planes[2] = {v.data - frame.data, v.rowStride, cw, ch, 1};
+        return true;
+    }
+    
+    // NV12/NV21: U and V interleave into one plane of 2-byte samples
+    const FramePlane& first = (frame.format == FORMAT_NV12) ? u : v;
+    const FramePlane& second = (frame.format == FORMAT_NV12) ? v : u;
+    if (u.pixelStride != 2 || v.pixelStride != 2 || u.rowStride != v.rowStride ||
+        second.data != first.data + 1) {
+        return false;
+    }
+    layout.count = 2;
+    layout.planes[1] = {first.data - frame.data, first.rowStride, cw, ch, 2};
+    return true;
+}
+
+} // namespace
+
+bool getFrameLayout(const FrameData& frame, PlaneLayout& layout) {
+    if (frame.planeCount > 0) {
+        return getWrappedLayout(frame, layout);
+    }
+    
+    if (frame.cropLeft < 0 || frame.cropTop < 0 || frame.sliceHeight < 0) {
+        return false;
+    }
+    
+    // Lay out the whole buffer (decoders pad rows and planes), then move
+    // every plane to the visible area
+    int fullWidth = frame.cropLeft + frame.width;
+    int fullHeight = std::max(frame.sliceHeight, frame.cropTop + frame.height);
+    if (!getPlaneLayout(frame.format, fullWidth, fullHeight, frame.stride, layout)) {
+        return false;
+    }
+    
+    bool yuv = isYuv(frame.format);
+    if (yuv && (frame.cropLeft % 2 != 0 || frame.cropTop % 2 != 0 ||
+                frame.width % 2 != 0 || frame.height % 2 != 0)) {
+        return false;
+    }
+    for (int i = 0; i < layout.count; i++) {
+        Plane& p = layout.planes[i];
+        int sub = (yuv && i > 0) ? 2 : 1;
+        p.offset += static_cast<ptrdiff_t>(frame.cropTop / sub) * p.stride +
+                    static_cast<ptrdiff_t>(frame.cropLeft / sub) * p.bpp;
+        p.width = frame.width / sub;
+        p.height = frame.height / sub;
+    }
+    return frame.size >= getLayoutSize(layout);
+}
+
+bool isPacked(const FrameData& frame) {
+    PlaneLayout layout;
+    return frame.planeCount == 0 &&
+           getPlaneLayout(frame.format, frame.width, frame.height, 0, layout) &&
+           (frame.stride == 0 || frame.stride == layout.planes[0].stride) &&
+           (frame.sliceHeight == 0 || frame.sliceHeight == frame.height) &&
+           frame.cropLeft == 0 && frame.cropTop == 0;
+}
+
+bool wrapPlanes(FrameData& frame, int width, int height,
+                const FramePlane* planes, int count) {
+    FrameFormat format;
+    if (count == 1 && planes[0].pixelStride == 3) {
+        format = FORMAT_RGB;
+    } else if (count == 1 && planes[0].pixelStride == 4) {
+        format = FORMAT_RGBA;
+    } else if (count == 3 && planes[1].pixelStride == 1) {
+        format = FORMAT_YUV420;
+    } else if (count == 3 && planes[2].data == planes[1].data + 1) {
+        format = FORMAT_NV12;
+    } else if (count == 3 && planes[1].data == planes[2].data + 1) {
+        format = FORMAT_NV21;
+    } else {
+        LOGE("wrapPlanes: Unsupported plane arrangement (%d planes)", count);
+        return false;
+    }
+    
+    frame.release();
+    frame.data = planes[0].data;
+    frame.ownsData = false;
+    frame.size = planes[0].length;
+    frame.width = width;
+    frame.height = height;
+    frame.format = format;
+    frame.stride = planes[0].rowStride;
+    frame.sliceHeight = 0;
+    frame.cropLeft = 0;
+    frame.cropTop = 0;
+    frame.timestamp = 0;
+    frame.planeCount = count;
+    for (int i = 0; i < count; i++) {
+        frame.planes[i] = planes[i];
+    }
+    
+    PlaneLayout layout;
+    if (!getFrameLayout(frame, layout)) {
+        LOGE("wrapPlanes: Planes don't cover a %dx%d frame (format %d)",
+             width, height, format);
+        frame.release();
+        return false;
+    }
+    return true;
+}
+
+bool writePlane(const FrameData& src, int plane, const FramePlane& dst) {
+    PlaneLayout layout;
+    if (!getFrameLayout(src, layout) || plane < 0 || plane >= layout.count) {
+        return false;
+    }
+    const Plane& sp = layout.planes[plane];
+    if (dst.pixelStride < sp.bpp || !planeCovers(dst, sp.width, sp.height, sp.bpp)) {
+        LOGE("writePlane: Plane %d (%dx%d, pixel stride %d) doesn't fit %zu bytes",
+             plane, sp.width, sp.height, dst.pixelStride, dst.length);
+        return false;
+    }
+    
+    const uint8_t* in = src.data + sp.offset;
+    size_t rowBytes = static_cast<size_t>(sp.width) * sp.bpp;
+    for (int y = 0; y < sp.height; y++) {
+        const uint8_t* inRow = in + static_cast<size_t>(y) * sp.stride;
+        uint8_t* outRow = dst.data + static_cast<size_t>(y) * dst.rowStride;
+        if (dst.pixelStride == sp.bpp) {
+            memcpy(outRow, inRow, rowBytes);
+        } else if (sp.bpp == 1) {
+            // Planar chroma into one half of interleaved chroma
+            for (int x = 0; x < sp.width; x++) {
+                outRow[static_cast<size_t>(x) * dst.pixelStride] = inRow[x];
+            }
+        } else {
+            for (int x = 0; x < sp.width; x++) {
+                memcpy(outRow + static_cast<size_t>(x) * dst.pixelStride,
+                       inRow + static_cast<size_t>(x) * sp.bpp, sp.bpp);
+            }
+        }
+    }
+    return true;
+}
+
+bool prepareFrame(FrameData& dst, FrameFormat format, int width, int height,
+                  PlaneLayout& layout) {
+    if (!getPlaneLayout(format, width, height, 0, layout)) {
+        return false;
+    }
+    const Plane& last = layout.planes[layout.count - 1];
+    dst.width = width;
+    dst.height = height;
+    dst.format = format;
+    dst.stride = layout.planes[0].stride;
+    dst.sliceHeight = 0;
+    dst.cropLeft = 0;
+    dst.cropTop = 0;
+    dst.allocate(static_cast<size_t>(last.offset) + static_cast<size_t>(last.stride) * last.height);
+    return true;
+}
+
+void rotatePlane90(const uint8_t* src, const Plane& srcPlane,
+                   uint8_t* dst, const Plane& dstPlane,
+                   bool clockwise, bool mirror) {
+    // Every 90 degree rotation, mirrored or not, is a transpose with the
+    // source and/or destination rows walked bottom-up
+    const uint8_t* in = src + srcPlane.offset;
+    uint8_t* out = dst + dstPlane.offset;
+    int inStride = srcPlane.stride;
+    int outStride = dstPlane.stride;
+    if (clockwise) {
+        in += static_cast<ptrdiff_t>(srcPlane.height - 1) * inStride;
+        inStride = -inStride;
+    }
+    if (clockwise == mirror) {
+        out += static_cast<ptrdiff_t>(dstPlane.height - 1) * outStride;
+        outStride = -outStride;
+    }
+    FrameSimd::best().transpose(in, inStride, out, outStride,
+                                srcPlane.width, srcPlane.height, srcPlane.bpp);
+}
+
+namespace {
+
+template <int BPP>
+void reverseRow(uint8_t* row, int width) {
+    uint8_t* left = row;
+    uint8_t* right = row + (width - 1) * BPP;
+    for (; left < right; left += BPP, right -= BPP) {
+        for (int c = 0; c < BPP; c++) {
+            std::swap(left[c], right[c]);
+        }
+    }
+}
+
+template <int BPP>
+void flipPlaneFixed(uint8_t* base, const Plane& p) {
+    for (int y = 0; y < p.height; y++) {
+        reverseRow<BPP>(base + static_cast<size_t>(y) * p.stride, p.width);
+    }
+}
+
+template <int BPP>
+void rotatePlane180Fixed(uint8_t* base, const Plane& p) {
+    // Swap row y with row (height - 1 - y) reversed
+    for (int y = 0; y < p.height / 2; y++) {
+        uint8_t* top = base + static_cast<size_t>(y) * p.stride;
+        uint8_t* bottom = base + static_cast<size_t>(p.height - 1 - y) * p.stride +
+                          (p.width - 1) * BPP;
+        for (int x = 0; x < p.width; x++, top += BPP, bottom -= BPP) {
+            for (int c = 0; c < BPP; c++) {
+                std::swap(top[c], bottom[c]);
             }
         }
     }
     
+    // The middle row of an odd-height plane only needs reversing
+    if (p.height % 2 != 0) {
+        reverseRow<BPP>(base + static_cast<size_t>(p.height / 2) * p.stride, p.width);
+    }
+}
+
+void rotatePlane180(uint8_t* base, const Plane& p) {
+    switch (p.bpp) {
+    case 1: rotatePlane180Fixed<1>(base, p); break;
+    case 2: rotatePlane180Fixed<2>(base, p); break;
+    case 3: rotatePlane180Fixed<3>(base, p); break;
+    default: rotatePlane180Fixed<4>(base, p); break;
+    }
+}
+
+bool rotate90(const FrameData& src, FrameData& dst, bool clockwise) {
+    PlaneLayout srcLayout;
+    if (!src.data || !getFrameLayout(src, srcLayout)) {
+        LOGE("rotate90: Unsupported frame (format %d, %dx%d)",
+             src.format, src.width, src.height);
+        return false;
+    }
+    
+    // Rotated dimensions are swapped
+    PlaneLayout dstLayout;
+    if (!prepareFrame(dst, src.format, src.height, src.width, dstLayout)) {
+        return false;
+    }
+    
+    for (int i = 0; i < srcLayout.count; i++) {
+        const Plane& sp = srcLayout.planes[i];
+        const Plane& dp = dstLayout.planes[i];
+        rotatePlane90(src.data, sp, dst.data, dp, clockwise, false);
+    }
+    return true;
+}
+
+} // namespace
+
+void flipPlane(uint8_t* base, const Plane& p) {
+    uint8_t* plane = base + p.offset;
+    switch (p.bpp) {
+    case 1: flipPlaneFixed<1>(plane, p); break;
+    case 2: flipPlaneFixed<2>(plane, p); break;
+    case 3: flipPlaneFixed<3>(plane, p); break;
+    default: flipPlaneFixed<4>(plane, p); break;
+    }
+}
+
+bool scaleFrame(const FrameData& src, FrameData& dst, 
+                int targetWidth, int targetHeight) {
+    PipelineStats::ScopedTimer timer(PipelineStats::STAGE_SCALE);
+    
+    if (!src.data || src.size == 0) {
+        LOGE("scaleFrame: Invalid source frame");
+        return false;
+    }
+    
+    PlaneLayout srcLayout;
+    PlaneLayout dstLayout;
+    if (!getFrameLayout(src, srcLayout) ||
+        !prepareFrame(dst, src.format, targetWidth, targetHeight, dstLayout)) {
+        LOGE("scaleFrame: Unsupported scale %dx%d -> %dx%d (format %d)",
+             src.width, src.height, targetWidth, targetHeight, src.format);
+        return false;
+    }
+    
+    // Fixed-point bilinear with cached coefficient tables, plane by plane
+    for (int i = 0; i < srcLayout.count; i++) {
+        const Plane& sp = srcLayout.planes[i];
+        const Plane& dp = dstLayout.planes[i];
+        std::shared_ptr<const FrameScaler::Plan> plan =
+            FrameScaler::getPlan(sp.width, sp.height, dp.width, dp.height);
+        FrameScaler::scalePlane(*plan, sp.bpp, src.data + sp.offset, sp.stride,
+                                dst.data + dp.offset, dp.stride);
+    }
+    
     LOGD("Scaled frame from %dx%d to %dx%d", 
          src.width, src.height, targetWidth, targetHeight);
     return true;
 }
 
-bool convertFormat(const FrameData& src, FrameData& dst, int targetFormat) {
+bool convertFormat(const FrameData& src, FrameData& dst, FrameFormat targetFormat) {
+    PipelineStats::ScopedTimer timer(PipelineStats::STAGE_CONVERT);
+    
     if (!src.data || src.size == 0) {
         LOGE("convertFormat: Invalid source frame");
         return false;
     }
     
+    // Padded decoder output: repack (and convert) through the plane-aware
+    // transform rather than the packed-only converters below
+    if (!isPacked(src)) {
+        return FrameTransform::apply(src, dst, targetFormat, src.width, src.height,
+                                     FrameTransform::Orientation{0, false});
+    }
+    
     // Same format, just copy
     if (src.format == targetFormat) {
         dst.width = src.width;
         dst.height = src.height;
         dst.format = src.format;
         dst.stride = src.stride;
-        dst.size = src.size;
-        dst.data = new uint8_t[dst.size];
+        dst.sliceHeight = 0;
+        dst.cropLeft = 0;
+        dst.cropTop = 0;
+        dst.allocate(src.size);
         memcpy(dst.data, src.data, src.size);
         return true;
     }
@@ -105,26 +444,28 @@ bool convertFormat(const FrameData& src, FrameData& dst, int targetFormat) {
     dst.width = src.width;
     dst.height = src.height;
     dst.format = targetFormat;
-    
-    // RGB (3) to NV21 (0)
-    if (src.format == 3 && targetFormat == 0) {
-        dst.size = calcNv21Size(src.width, src.height);
-        dst.data = new uint8_t[dst.size];
+    dst.sliceHeight = 0;
+    dst.cropLeft = 0;
+    dst.cropTop = 0;
+    
+    // RGB to NV21
+    if (src.format == FORMAT_RGB && targetFormat == FORMAT_NV21) {
+        dst.stride = src.width;
+        dst.allocate(calcNv21Size(src.width, src.height));
         return rgbToNv21(src.data, dst.data, src.width, src.height);
     }
     
-    // RGB (3) to YUV420 (1)
-    if (src.format == 3 && targetFormat == 1) {
-        dst.size = calcYuv420Size(src.width, src.height);
-        dst.data = new uint8_t[dst.size];
+    // RGB to YUV420
+    if (src.format == FORMAT_RGB && targetFormat == FORMAT_YUV420) {
+        dst.stride = src.width;
+        dst.allocate(calcYuv420Size(src.width, src.height));
         return rgbToYuv420(src.data, dst.data, src.width, src.height);
     }
     
-    // NV21 (0) to RGB (3)
-    if (src.format == 0 && targetFormat == 3) {
-        dst.size = calcRgbSize(src.width, src.height);
+    // NV21 to RGB
+    if (src.format == FORMAT_NV21 && targetFormat == FORMAT_RGB) {
         dst.stride = src.width * 3;
-        dst.data = new uint8_t[dst.size];
+        dst.allocate(calcRgbSize(src.width, src.height));
         return nv21ToRgb(src.data, dst.data, src.width, src.height);
     }
     
@@ -134,26 +475,15 @@ bool convertFormat(const FrameData& src, FrameData& dst, int targetFormat) {
 }
 
 bool flipHorizontal(FrameData& frame) {
-    if (!frame.data || frame.size == 0) {
+    PlaneLayout layout;
+    if (!frame.data || !getFrameLayout(frame, layout)) {
+        LOGE("flipHorizontal: Unsupported frame (format %d, %dx%d)",
+             frame.format, frame.width, frame.height);
         return false;
     }
     
-    int bpp = 3;
-    if (frame.format == 2) bpp = 4;  // RGBA
-    else if (frame.format == 0 || frame.format == 1) {
-        LOGE("flipHorizontal: NV21/YUV420 flip not implemented");
-        return false;
-    }
-    
-    for (int y = 0; y < frame.height; y++) {
-        for (int x = 0; x < frame.width / 2; x++) {
-            int leftIdx = (y * frame.width + x) * bpp;
-            int rightIdx = (y * frame.width + (frame.width - 1 - x)) * bpp;
-            
-            for (int c = 0; c < bpp; c++) {
-                std::swap(frame.data[leftIdx + c], frame.data[rightIdx + c]);
-            }
-        }
+    for (int i = 0; i < layout.count; i++) {
+        flipPlane(frame.data, layout.planes[i]);
     }
     
     LOGD("Flipped frame horizontally");
@@ -161,99 +491,35 @@ bool flipHorizontal(FrameData& frame) {
 }
 
 bool rotate90CW(const FrameData& src, FrameData& dst) {
-    if (!src.data || src.size == 0) {
-        return false;
-    }
-    
-    int bpp = 3;
-    if (src.format == 2) bpp = 4;
-    else if (src.format != 3) {
-        LOGE("rotate90CW: Only RGB/RGBA formats supported");
+    if (!rotate90(src, dst, true)) {
         return false;
     }
     
-    // Rotated dimensions are swapped
-    dst.width = src.height;
-    dst.height = src.width;
-    dst.format = src.format;
-    dst.stride = dst.width * bpp;
-    dst.size = dst.stride * dst.height;
-    dst.data = new uint8_t[dst.size];
-    
-    for (int y = 0; y < src.height; y++) {
-        for (int x = 0; x < src.width; x++) {
-            int srcIdx = (y * src.width + x) * bpp;
-            int dstX = src.height - 1 - y;
-            int dstY = x;
-            int dstIdx = (dstY * dst.width + dstX) * bpp;
-            
-            for (int c = 0; c < bpp; c++) {
-                dst.data[dstIdx + c] = src.data[srcIdx + c];
-            }
-        }
-    }
-    
     LOGD("Rotated frame 90° CW: %dx%d -> %dx%d", 
          src.width, src.height, dst.width, dst.height);
     return true;
 }
 
 bool rotate90CCW(const FrameData& src, FrameData& dst) {
-    if (!src.data || src.size == 0) {
+    if (!rotate90(src, dst, false)) {
         return false;
     }
     
-    int bpp = 3;
-    if (src.format == 2) bpp = 4;
-    else if (src.format != 3) {
-        LOGE("rotate90CCW: Only RGB/RGBA formats supported");
-        return false;
-    }
-    
-    dst.width = src.height;
-    dst.height = src.width;
-    dst.format = src.format;
-    dst.stride = dst.width * bpp;
-    dst.size = dst.stride * dst.height;
-    dst.data = new uint8_t[dst.size];
-    
-    for (int y = 0; y < src.height; y++) {
-        for (int x = 0; x < src.width; x++) {
-            int srcIdx = (y * src.width + x) * bpp;
-            int dstX = y;
-            int dstY = src.width - 1 - x;
-            int dstIdx = (dstY * dst.width + dstX) * bpp;
-            
-            for (int c = 0; c < bpp; c++) {
-                dst.data[dstIdx + c] = src.data[srcIdx + c];
-            }
-        }
-    }
-    
     LOGD("Rotated frame 90° CCW: %dx%d -> %dx%d",
          src.width, src.height, dst.width, dst.height);
     return true;
 }
 
 bool rotate180(FrameData& frame) {
-    if (!frame.data || frame.size == 0) {
+    PlaneLayout layout;
+    if (!frame.data || !getFrameLayout(frame, layout)) {
+        LOGE("rotate180: Unsupported frame (format %d, %dx%d)",
+             frame.format, frame.width, frame.height);
         return false;
     }
     
-    int bpp = 3;
-    if (frame.format == 2) bpp = 4;
-    else if (frame.format != 3) {
-        LOGE("rotate180: Only RGB/RGBA formats supported");
-        return false;
-    }
-    
-    int totalPixels = frame.width * frame.height;
-    
-    for (int i = 0; i < totalPixels / 2; i++) {
-        int j = totalPixels - 1 - i;
-        for (int c = 0; c < bpp; c++) {
-            std::swap(frame.data[i * bpp + c], frame.data[j * bpp + c]);
-        }
+    for (int i = 0; i < layout.count; i++) {
+        rotatePlane180(frame.data + layout.planes[i].offset, layout.planes[i]);
     }
     
     LOGD("Rotated frame 180°");
@@ -261,24 +527,9 @@ bool rotate180(FrameData& frame) {
 }
 
 bool applyFrontCameraTransform(const FrameData& src, FrameData& dst) {
-    // For front camera: horizontal flip + 90° rotation
-    
-    // First, copy and flip horizontally
-    FrameData flipped;
-    flipped.width = src.width;
-    flipped.height = src.height;
-    flipped.format = src.format;
-    flipped.stride = src.stride;
-    flipped.size = src.size;
-    flipped.data = new uint8_t[flipped.size];
-    memcpy(flipped.data, src.data, src.size);
-    
-    if (!flipHorizontal(flipped)) {
-        return false;
-    }
-    
-    // Then rotate 90° clockwise
-    return rotate90CW(flipped, dst);
+    // For front camera: horizontal flip + 90° rotation, in one pass
+    return FrameTransform::apply(src, dst, src.format, src.height, src.width,
+                                 FrameTransform::Orientation{90, true});
 }
 
 bool matchResolution(const FrameData& src, FrameData& dst,
@@ -288,14 +539,22 @@ bool matchResolution(const FrameData& src, FrameData& dst,
         return false;
     }
     
+    if (src.width == targetWidth && src.height == targetHeight && !isPacked(src)) {
+        // Already matching, repack the visible area
+        return FrameTransform::apply(src, dst, src.format, targetWidth, targetHeight,
+                                     FrameTransform::Orientation{0, false});
+    }
+    
     if (src.width == targetWidth && src.height == targetHeight) {
         // Already matching, just copy
         dst.width = src.width;
         dst.height = src.height;
         dst.format = src.format;
         dst.stride = src.stride;
-        dst.size = src.size;
-        dst.data = new uint8_t[dst.size];
+        dst.sliceHeight = 0;
+        dst.cropLeft = 0;
+        dst.cropTop = 0;
+        dst.allocate(src.size);
         memcpy(dst.data, src.data, src.size);
         return true;
     }
@@ -320,6 +579,12 @@ bool matchResolution(const FrameData& src, FrameData& dst,
         scaleWidth = static_cast<int>(targetHeight * srcAspect);
     }
     
+    // Chroma subsampling needs even sizes and offsets
+    if (isYuv(src.format)) {
+        scaleWidth &= ~1;
+        scaleHeight &= ~1;
+    }
+    
     // Scale the frame
     FrameData scaled;
     if (!scaleFrame(src, scaled, scaleWidth, scaleHeight)) {
@@ -327,26 +592,38 @@ bool matchResolution(const FrameData& src, FrameData& dst,
     }
     
     // Create output with padding
-    int bpp = (src.format == 2) ? 4 : 3;
-    dst.width = targetWidth;
-    dst.height = targetHeight;
-    dst.format = src.format;
-    dst.stride = targetWidth * bpp;
-    dst.size = dst.stride * targetHeight;
-    dst.data = new uint8_t[dst.size];
-    
-    // Fill with black
-    memset(dst.data, 0, dst.size);
+    PlaneLayout dstLayout;
+    PlaneLayout scaledLayout;
+    if (!prepareFrame(dst, src.format, targetWidth, targetHeight, dstLayout) ||
+        !getFrameLayout(scaled, scaledLayout)) {
+        return false;
+    }
     
     // Calculate offset for centering
     int offsetX = (targetWidth - scaleWidth) / 2;
     int offsetY = (targetHeight - scaleHeight) / 2;
+    if (isYuv(src.format)) {
+        offsetX &= ~1;
+        offsetY &= ~1;
+    }
     
-    // Copy scaled frame into center
-    for (int y = 0; y < scaleHeight; y++) {
-        int srcRow = y * scaleWidth * bpp;
-        int dstRow = ((y + offsetY) * targetWidth + offsetX) * bpp;
-        memcpy(dst.data + dstRow, scaled.data + srcRow, scaleWidth * bpp);
+    for (int i = 0; i < dstLayout.count; i++) {
+        const Plane& dp = dstLayout.planes[i];
+        const Plane& sp = scaledLayout.planes[i];
+        uint8_t* dstPlane = dst.data + dp.offset;
+        
+        // Fill with black (limited-range YUV black is Y=16, U=V=128)
+        int fill = isYuv(src.format) ? (i == 0 ? 16 : 128) : 0;
+        memset(dstPlane, fill, static_cast<size_t>(dp.stride) * dp.height);
+        
+        // Copy scaled plane into center
+        int planeX = offsetX * dp.width / targetWidth;
+        int planeY = offsetY * dp.height / targetHeight;
+        for (int y = 0; y < sp.height; y++) {
+            memcpy(dstPlane + static_cast<size_t>(y + planeY) * dp.stride + planeX * dp.bpp,
+                   scaled.data + sp.offset + static_cast<size_t>(y) * sp.stride,
+                   static_cast<size_t>(sp.width) * sp.bpp);
+        }
     }
     
     LOGD("Matched resolution %dx%d -> %dx%d (scaled to %dx%d, padded)",
@@ -367,41 +644,10 @@ bool rgbToNv21(const uint8_t* rgb, uint8_t* nv21, int width, int height) {
         return false;
     }
     
+    // Y plane followed by interleaved VU pairs, one per 2x2 pixel block
     int ySize = width * height;
-    // UV plane has interleaved VU pairs, size = width * height / 2
-    
-    uint8_t* yPlane = nv21;
-    uint8_t* uvPlane = nv21 + ySize;
-    
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            int rgbIdx = (j * width + i) * 3;
-            int r = rgb[rgbIdx];
-            int g = rgb[rgbIdx + 1];
-            int b = rgb[rgbIdx + 2];
-            
-            // RGB to Y
-            int y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
-            yPlane[j * width + i] = clamp(y);
-            
-            // RGB to UV (sample every 2x2 block)
-            // NV21 format: VU interleaved, one VU pair per 2x2 pixel block
-            if (j % 2 == 0 && i % 2 == 0) {
-                int u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
-                int v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
-                
-                // Calculate index in UV plane: (j/2) * width + i gives VU pair index
-                // Each row in UV plane has width/2 VU pairs (width bytes total)
-                int uvRow = j / 2;
-                int uvCol = i;  // i is even, so this is the start of a VU pair
-                int uvIdx = uvRow * width + uvCol;
-                
-                uvPlane[uvIdx] = clamp(v);      // V first in NV21
-                uvPlane[uvIdx + 1] = clamp(u);  // Then U
-            }
-        }
-    }
-    
+    FrameSimd::best().rgbToNv21(rgb, width * 3, nv21, width,
+                                nv21 + ySize, width, width, height);
     return true;
 }
 
@@ -411,29 +657,8 @@ bool nv21ToRgb(const uint8_t* nv21, uint8_t* rgb, int width, int height) {
     }
     
     int ySize = width * height;
-    const uint8_t* yPlane = nv21;
-    const uint8_t* uvPlane = nv21 + ySize;
-    
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            int y = yPlane[j * width + i];
-            int uvIdx = (j / 2) * width + (i & ~1);
-            int v = uvPlane[uvIdx] - 128;
-            int u = uvPlane[uvIdx + 1] - 128;
-            
-            // YUV to RGB
-            int c = y - 16;
-            int r = (298 * c + 409 * v + 128) >> 8;
-            int g = (298 * c - 100 * u - 208 * v + 128) >> 8;
-            int b = (298 * c + 516 * u + 128) >> 8;
-            
-            int rgbIdx = (j * width + i) * 3;
-            rgb[rgbIdx] = clamp(r);
-            rgb[rgbIdx + 1] = clamp(g);
-            rgb[rgbIdx + 2] = clamp(b);
-        }
-    }
-    
+    FrameSimd::best().nv21ToRgb(nv21, width, nv21 + ySize, width,
+                                rgb, width * 3, width, height);
     return true;
 }
 
@@ -449,29 +674,9 @@ bool rgbToYuv420(const uint8_t* rgb, uint8_t* yuv420, int width, int height) {
     uint8_t* uPlane = yuv420 + ySize;
     uint8_t* vPlane = uPlane + uSize;
     
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            int rgbIdx = (j * width + i) * 3;
-            int r = rgb[rgbIdx];
-            int g = rgb[rgbIdx + 1];
-            int b = rgb[rgbIdx + 2];
-            
-            // RGB to Y
-            int y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
-            yPlane[j * width + i] = clamp(y);
-            
-            // RGB to UV (sample every 2x2 block)
-            if (j % 2 == 0 && i % 2 == 0) {
-                int u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
-                int v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
-                
-                int uvIdx = (j / 2) * (width / 2) + (i / 2);
-                uPlane[uvIdx] = clamp(u);
-                vPlane[uvIdx] = clamp(v);
-            }
-        }
-    }
-    
+    FrameSimd::best().rgbToI420(rgb, width * 3, yPlane, width,
+                                uPlane, width / 2, vPlane, width / 2,
+                                width, height);
     return true;
 }
 
@@ -11,27 +11,88 @@
 
 #pragma once
 
+#include "frame_pool.hpp"
 #include <cstdint>
 #include <cstddef>
 
+// FrameData::format values
+enum FrameFormat {
+    FORMAT_NV21 = 0,    // Y plane + interleaved VU plane
+    FORMAT_YUV420 = 1,  // I420: Y, U, V planes
+    FORMAT_RGBA = 2,
+    FORMAT_RGB = 3,
+    FORMAT_NV12 = 4,    // Y plane + interleaved UV plane
+};
+
+// One plane of externally stored pixels, as AImage reports it
+struct FramePlane {
+    uint8_t* data;
+    int rowStride;    // Bytes between rows
+    int pixelStride;  // Bytes between samples (2 for interleaved chroma)
+    size_t length;    // Bytes addressable from data
+};
+
 // Frame data structure
 struct FrameData {
     uint8_t* data;
     size_t size;
     int width;
     int height;
-    int format;  // 0=NV21, 1=YUV420, 2=RGBA, 3=RGB
-    int stride;
+    FrameFormat format;
+    int stride;  // Bytes per row of the first plane
+    int sliceHeight;  // Rows of the first plane before the next starts (0 = height)
+    int cropLeft;  // Origin of the width x height visible area within the
+    int cropTop;   // planes (even for YUV formats)
     int64_t timestamp;
+    bool ownsData;  // false for views into buffers owned elsewhere (FrameRef)
+    size_t capacity;  // FramePool block size backing an owned data pointer
+    
+    // Planes addressed in place (see FrameUtils::wrapPlanes). When
+    // planeCount > 0 they replace the layout derived from data, stride,
+    // sliceHeight and the crop origin; YUV frames list Y, U and V.
+    FramePlane planes[3];
+    int planeCount;
+    
+    // External ownership: called when a frame that doesn't own its data
+    // lets go of it (e.g. to delete the AImage whose planes it addresses)
+    void (*onRelease)(void* context);
+    void* releaseContext;
     
     FrameData() : data(nullptr), size(0), width(0), height(0), 
-                  format(0), stride(0), timestamp(0) {}
+                  format(FORMAT_NV21), stride(0), sliceHeight(0), cropLeft(0), cropTop(0),
+                  timestamp(0), ownsData(true), capacity(0), planes(), planeCount(0),
+                  onRelease(nullptr), releaseContext(nullptr) {}
     
     ~FrameData() {
-        if (data) {
-            delete[] data;
-            data = nullptr;
+        release();
+    }
+    
+    // Get `bytes` of owned pixel storage from the frame pool. An owned
+    // block that is already large enough is reused as is.
+    uint8_t* allocate(size_t bytes) {
+        if (!data || !ownsData || capacity < bytes) {
+            release();
+            data = FramePool::acquire(bytes, &capacity);
+        }
+        size = bytes;
+        planeCount = 0;
+        return data;
+    }
+    
+    // Return (or detach from) the pixel data
+    void release() {
+        if (data && ownsData) {
+            FramePool::release(data, capacity);
+        }
+        if (onRelease) {
+            onRelease(releaseContext);
         }
+        data = nullptr;
+        ownsData = true;
+        capacity = 0;
+        planeCount = 0;
+        onRelease = nullptr;
+        releaseContext = nullptr;
     }
     
     // Prevent copying
@@ -39,43 +100,118 @@ struct FrameData {
     FrameData& operator=(const FrameData&) = delete;
     
     // Allow moving
-    FrameData(FrameData&& other) noexcept {
+    FrameData(FrameData&& other) noexcept : FrameData() {
+        takeFrom(other);
+    }
+    
+    FrameData& operator=(FrameData&& other) noexcept {
+        if (this != &other) {
+            release();
+            takeFrom(other);
+        }
+        return *this;
+    }
+
+private:
+    void takeFrom(FrameData& other) {
         data = other.data;
         size = other.size;
         width = other.width;
         height = other.height;
         format = other.format;
         stride = other.stride;
+        sliceHeight = other.sliceHeight;
+        cropLeft = other.cropLeft;
+        cropTop = other.cropTop;
         timestamp = other.timestamp;
+        ownsData = other.ownsData;
+        capacity = other.capacity;
+        planeCount = other.planeCount;
+        for (int i = 0; i < planeCount; i++) {
+            planes[i] = other.planes[i];
+        }
+        onRelease = other.onRelease;
+        releaseContext = other.releaseContext;
         other.data = nullptr;
         other.size = 0;
-    }
-    
-    FrameData& operator=(FrameData&& other) noexcept {
-        if (this != &other) {
-            if (data) delete[] data;
-            data = other.data;
-            size = other.size;
-            width = other.width;
-            height = other.height;
-            format = other.format;
-            stride = other.stride;
-            timestamp = other.timestamp;
-            other.data = nullptr;
-            other.size = 0;
-        }
-        return *this;
+        other.ownsData = true;
+        other.capacity = 0;
+        other.planeCount = 0;
+        other.onRelease = nullptr;
+        other.releaseContext = nullptr;
     }
 };
 
 namespace FrameUtils {
 
+// One plane of a frame, `bpp` interleaved bytes per sample
+struct Plane {
+    ptrdiff_t offset;  // From FrameData::data (negative for some external planes)
+    int stride;
+    int width;
+    int height;
+    int bpp;
+};
+
+struct PlaneLayout {
+    int count;
+    Plane planes[3];
+};
+
+// True for NV21, NV12 and YUV420
+bool isYuv(FrameFormat format);
+
+// Where each plane of a width x height frame lives. `stride` is the row
+// pitch of the first plane (0 = tightly packed); chroma follows the luma
+// rows directly, as in the buffers MediaCodec and the camera hand out.
+bool getPlaneLayout(FrameFormat format, int width, int height, int stride,
+                    PlaneLayout& layout);
+
+// Bytes spanned by all planes of a layout
+size_t getLayoutSize(const PlaneLayout& layout);
+
+// Layout of the visible area of `frame` (honouring stride, slice height
+// and crop), checking that its buffer actually covers it
+bool getFrameLayout(const FrameData& frame, PlaneLayout& layout);
+
+// True if `frame` is tightly packed, with nothing around the visible area
+bool isPacked(const FrameData& frame);
+
+// Point `frame` at external planes without copying: one RGB/RGBA plane
+// (pixel stride 3 or 4) or Y, U and V planes as AImage reports them.
+// NV12, NV21 or YUV420 is worked out from how U and V interleave. The
+// frame doesn't own the memory; set onRelease to tie it to its owner.
+bool wrapPlanes(FrameData& frame, int width, int height,
+                const FramePlane* planes, int count);
+
+// Copy plane `plane` of `src` into external memory with its own row and
+// pixel stride. Samples land dst.pixelStride apart, so writing U and V
+// of an I420 frame into interleaved chroma leaves the other's bytes be.
+bool writePlane(const FrameData& src, int plane, const FramePlane& dst);
+
+// Set up `dst` as a tightly packed width x height frame of `format`
+bool prepareFrame(FrameData& dst, FrameFormat format, int width, int height,
+                  PlaneLayout& layout);
+
+// Rotate one plane of `src` by 90 degrees into the matching plane of
+// `dst` (both are frame base pointers), optionally mirroring it first.
+// Runs as a cache-blocked SIMD transpose.
+void rotatePlane90(const uint8_t* src, const Plane& srcPlane,
+                   uint8_t* dst, const Plane& dstPlane,
+                   bool clockwise, bool mirror);
+
+// Mirror one plane of a frame (`base` is the frame base pointer) in place
+void flipPlane(uint8_t* base, const Plane& p);
+
+// Scale, flip and rotate work on RGB/RGBA and directly on the planes of
+// NV21, NV12 and YUV420 frames (even dimensions), without converting.
+
 // Scale frame to target resolution
 bool scaleFrame(const FrameData& src, FrameData& dst, 
                 int targetWidth, int targetHeight);
 
 // Convert frame format
-bool convertFormat(const FrameData& src, FrameData& dst, int targetFormat);
+bool convertFormat(const FrameData& src, FrameData& dst, FrameFormat targetFormat);
 
 // Flip frame horizontally (for front camera)
 bool flipHorizontal(FrameData& frame);
@@ -89,7 +225,8 @@ bool rotate90CCW(const FrameData& src, FrameData& dst);
 // Rotate frame by 180 degrees
 bool rotate180(FrameData& frame);
 
-// Apply front camera transformation (horizontal flip + 90° rotation)
+// Apply front camera transformation (horizontal flip + 90° rotation).
+// See FrameTransform::apply to also scale and convert in the same pass.
 bool applyFrontCameraTransform(const FrameData& src, FrameData& dst);
 
 // Match frame resolution to target (scale + pad if needed)
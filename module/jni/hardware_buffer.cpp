@@ -0,0 +1,341 @@
+/*
+ * DroidFakeCam - Hardware Buffer Implementation
+ *
+ * Handles live in small FramePool blocks like FrameBuffer headers. On
+ * device a handle either owns an AHardwareBuffer it allocated or an AImage
+ * acquired from a HardwareImageReader (whose AHardwareBuffer the codec
+ * rendered into); releasing the last reference frees the buffer or gives
+ * the image back to the reader's queue. Host builds substitute FramePool
+ * memory for the graphics buffer and have no reader.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "hardware_buffer.hpp"
+#include "frame_pool.hpp"
+#include <android/log.h>
+#include <cstddef>
+#include <new>
+
+#ifdef __ANDROID__
+#include <android/hardware_buffer.h>
+#include <media/NdkImage.h>
+#include <media/NdkImageReader.h>
+#endif
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+using FrameUtils::PlaneLayout;
+
+namespace {
+
+// Stand-in pixels start after the header, padded to a cache line
+constexpr size_t kHeaderSize = (sizeof(HardwareBuffer) + 63) & ~size_t(63);
+
+void fillView(FrameData& frame, uint8_t* data, int width, int height,
+              FrameFormat format, int stride) {
+    PlaneLayout layout;
+    FrameUtils::getPlaneLayout(format, width, height, stride, layout);
+
+    frame.release();
+    frame.data = data;
+    frame.ownsData = false;
+    frame.size = FrameUtils::getLayoutSize(layout);
+    frame.width = width;
+    frame.height = height;
+    frame.format = format;
+    frame.stride = layout.planes[0].stride;
+    frame.sliceHeight = 0;
+    frame.cropLeft = 0;
+    frame.cropTop = 0;
+    frame.timestamp = 0;
+}
+
+#ifdef __ANDROID__
+
+// RGB and RGBA map to native formats; YUV frames are stored as a BLOB in
+// the tightly packed FrameUtils layout so a CPU lock sees the same planes
+bool describeBuffer(int width, int height, FrameFormat format,
+                    AHardwareBuffer_Desc& desc) {
+    desc = {};
+    desc.layers = 1;
+    desc.usage = AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN |
+                 AHARDWAREBUFFER_USAGE_CPU_WRITE_OFTEN;
+
+    if (format == FORMAT_RGBA) {
+        desc.format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM;
+        desc.width = width;
+        desc.height = height;
+        desc.usage |= AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE;
+        return true;
+    }
+    if (format == FORMAT_RGB) {
+        desc.format = AHARDWAREBUFFER_FORMAT_R8G8B8_UNORM;
+        desc.width = width;
+        desc.height = height;
+        desc.usage |= AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE;
+        return true;
+    }
+
+    PlaneLayout layout;
+    if (!FrameUtils::getPlaneLayout(format, width, height, 0, layout)) {
+        return false;
+    }
+    desc.format = AHARDWAREBUFFER_FORMAT_BLOB;
+    desc.width = static_cast<uint32_t>(FrameUtils::getLayoutSize(layout));
+    desc.height = 1;
+    return true;
+}
+
+// Work out which FrameData layout an AImage's YUV_420_888 planes form.
+// Only layouts with chroma a whole number of luma rows (the slice height)
+// after the luma plane qualify.
+bool lockImage(AImage* image, int width, int height, FrameData& frame) {
+    FramePlane planes[3];
+    for (int i = 0; i < 3; i++) {
+        int length = 0;
+        int32_t rowStride = 0;
+        int32_t pixelStride = 0;
+        if (AImage_getPlaneData(image, i, &planes[i].data, &length) != AMEDIA_OK ||
+            AImage_getPlaneRowStride(image, i, &rowStride) != AMEDIA_OK ||
+            AImage_getPlanePixelStride(image, i, &pixelStride) != AMEDIA_OK) {
+            LOGE("HardwareBuffer: Cannot map image plane %d", i);
+            return false;
+        }
+        planes[i].rowStride = rowStride;
+        planes[i].pixelStride = pixelStride;
+        planes[i].length = static_cast<size_t>(length);
+    }
+
+    // Planes are addressed where they are, so padding between them (or
+    // separately allocated chroma) needs no copy
+    if (!FrameUtils::wrapPlanes(frame, width, height, planes, 3)) {
+        LOGE("HardwareBuffer: Image planes can't be described (pixel stride %d)",
+             planes[1].pixelStride);
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+} // namespace
+
+HardwareBuffer::HardwareBuffer(int width, int height, FrameFormat format, size_t blockSize)
+    : m_refs(1)
+    , m_width(width)
+    , m_height(height)
+    , m_format(format)
+    , m_blockSize(blockSize)
+    , m_native(nullptr)
+    , m_image(nullptr)
+    , m_reader(nullptr)
+{
+}
+
+HardwareBuffer* HardwareBuffer::allocate(int width, int height, FrameFormat format) {
+    PlaneLayout layout;
+    if (!FrameUtils::getPlaneLayout(format, width, height, 0, layout)) {
+        LOGE("HardwareBuffer: Unsupported buffer %dx%d (format %d)",
+             width, height, format);
+        return nullptr;
+    }
+
+#ifdef __ANDROID__
+    AHardwareBuffer_Desc desc;
+    AHardwareBuffer* native = nullptr;
+    if (!describeBuffer(width, height, format, desc) ||
+        AHardwareBuffer_allocate(&desc, &native) != 0) {
+        LOGE("HardwareBuffer: Allocation failed for %dx%d (format %d)",
+             width, height, format);
+        return nullptr;
+    }
+
+    size_t blockSize = 0;
+    uint8_t* block = FramePool::acquire(kHeaderSize, &blockSize);
+    HardwareBuffer* buffer = new (block) HardwareBuffer(width, height, format, blockSize);
+    buffer->m_native = native;
+#else
+    // Stand-in: header and pixels share one pool block
+    size_t blockSize = 0;
+    uint8_t* block = FramePool::acquire(kHeaderSize + FrameUtils::getLayoutSize(layout),
+                                        &blockSize);
+    HardwareBuffer* buffer = new (block) HardwareBuffer(width, height, format, blockSize);
+    buffer->m_native = block + kHeaderSize;
+#endif
+    return buffer;
+}
+
+void HardwareBuffer::addRef() {
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HardwareBuffer::release() {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+#ifdef __ANDROID__
+    if (m_image) {
+        AImage_delete(static_cast<AImage*>(m_image));
+    } else if (m_native) {
+        AHardwareBuffer_release(static_cast<AHardwareBuffer*>(m_native));
+    }
+#endif
+    // Images must go back before their reader can be deleted
+    HardwareImageReader* reader = m_reader;
+    size_t blockSize = m_blockSize;
+    this->~HardwareBuffer();
+    FramePool::release(reinterpret_cast<uint8_t*>(this), blockSize);
+
+    if (reader) {
+        reader->release();
+    }
+}
+
+bool HardwareBuffer::lock(FrameData& frame) {
+#ifdef __ANDROID__
+    if (m_image) {
+        // Image planes stay mapped for the image's lifetime
+        return lockImage(static_cast<AImage*>(m_image), m_width, m_height, frame);
+    }
+
+    void* pixels = nullptr;
+    AHardwareBuffer* native = static_cast<AHardwareBuffer*>(m_native);
+    if (AHardwareBuffer_lock(native, AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN,
+                             -1, nullptr, &pixels) != 0) {
+        LOGE("HardwareBuffer: Lock failed");
+        return false;
+    }
+
+    int stride = 0;
+    if (m_format == FORMAT_RGB || m_format == FORMAT_RGBA) {
+        AHardwareBuffer_Desc desc;
+        AHardwareBuffer_describe(native, &desc);
+        stride = static_cast<int>(desc.stride) * (m_format == FORMAT_RGBA ? 4 : 3);
+    }
+    fillView(frame, static_cast<uint8_t*>(pixels), m_width, m_height, m_format, stride);
+#else
+    fillView(frame, static_cast<uint8_t*>(m_native), m_width, m_height, m_format, 0);
+#endif
+    return true;
+}
+
+void HardwareBuffer::unlock() {
+#ifdef __ANDROID__
+    if (!m_image) {
+        AHardwareBuffer_unlock(static_cast<AHardwareBuffer*>(m_native), nullptr);
+    }
+#endif
+}
+
+HardwareImageReader::HardwareImageReader(void* reader, void* window,
+                                         int width, int height)
+    : m_refs(1)
+    , m_reader(reader)
+    , m_window(window)
+    , m_width(width)
+    , m_height(height)
+{
+}
+
+HardwareImageReader* HardwareImageReader::create(int width, int height, int maxImages) {
+#ifdef __ANDROID__
+    // Sampled by the GPU when the consumer takes the handle, read by the
+    // CPU when it needs pixels
+    uint64_t usage = AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
+                     AHARDWAREBUFFER_USAGE_CPU_READ_OFTEN;
+    AImageReader* reader = nullptr;
+    media_status_t status = AImageReader_newWithUsage(
+        width, height, AIMAGE_FORMAT_YUV_420_888, usage, maxImages, &reader);
+    if (status != AMEDIA_OK) {
+        LOGE("HardwareImageReader: Cannot create %dx%d reader: %d",
+             width, height, status);
+        return nullptr;
+    }
+
+    ANativeWindow* window = nullptr;
+    if (AImageReader_getWindow(reader, &window) != AMEDIA_OK || !window) {
+        LOGE("HardwareImageReader: Reader has no window");
+        AImageReader_delete(reader);
+        return nullptr;
+    }
+
+    LOGD("HardwareImageReader: %dx%d, %d images", width, height, maxImages);
+    return new HardwareImageReader(reader, window, width, height);
+#else
+    (void)width;
+    (void)height;
+    (void)maxImages;
+    return nullptr;
+#endif
+}
+
+void HardwareImageReader::addRef() {
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HardwareImageReader::release() {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+#ifdef __ANDROID__
+    AImageReader_delete(static_cast<AImageReader*>(m_reader));
+#endif
+    delete this;
+}
+
+HardwareBuffer* HardwareImageReader::acquire(int64_t* timestampUs) {
+#ifdef __ANDROID__
+    AImage* image = nullptr;
+    media_status_t status = AImageReader_acquireNextImage(
+        static_cast<AImageReader*>(m_reader), &image);
+    if (status != AMEDIA_OK || !image) {
+        if (status == AMEDIA_IMGREADER_MAX_IMAGES_ACQUIRED) {
+            LOGD("HardwareImageReader: All images are in use");
+        }
+        return nullptr;
+    }
+
+    AHardwareBuffer* native = nullptr;
+    if (AImage_getHardwareBuffer(image, &native) != AMEDIA_OK) {
+        native = nullptr;
+    }
+
+    if (timestampUs) {
+        int64_t timestampNs = 0;
+        AImage_getTimestamp(image, &timestampNs);
+        *timestampUs = timestampNs / 1000;
+    }
+
+    // The codec's YUV output is usually semi-planar; lock() tells for sure
+    size_t blockSize = 0;
+    uint8_t* block = FramePool::acquire(kHeaderSize, &blockSize);
+    HardwareBuffer* buffer = new (block) HardwareBuffer(m_width, m_height,
+                                                        FORMAT_NV12, blockSize);
+    buffer->m_native = native;
+    buffer->m_image = image;
+    buffer->m_reader = this;
+    addRef();
+    return buffer;
+#else
+    (void)timestampUs;
+    return nullptr;
+#endif
+}
+
+int HardwareImageReader::drain() {
+    int dropped = 0;
+#ifdef __ANDROID__
+    AImage* image = nullptr;
+    while (AImageReader_acquireNextImage(static_cast<AImageReader*>(m_reader),
+                                         &image) == AMEDIA_OK && image) {
+        AImage_delete(image);
+        image = nullptr;
+        dropped++;
+    }
+#endif
+    return dropped;
+}
@@ -0,0 +1,103 @@
+/*
+ * DroidFakeCam - Hardware Buffer Header
+ *
+ * Reference-counted handles to frames living in graphics memory. In
+ * hardware output mode MediaCodec renders into an AImageReader and each
+ * decoded image travels downstream as a handle instead of being copied
+ * into a FrameBuffer. Without the NDK (host builds) buffers are stand-ins
+ * backed by FramePool, so the ring and its consumers can be exercised
+ * off-device.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_utils.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class HardwareImageReader;
+
+class HardwareBuffer {
+public:
+    // Allocate a CPU-readable width x height buffer of `format`
+    // with a reference count of 1
+    static HardwareBuffer* allocate(int width, int height, FrameFormat format);
+
+    void addRef();
+
+    // Drop a reference; the last one frees the buffer or hands the image
+    // back to its reader
+    void release();
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    // Format the buffer was created with. For decoder images this is the
+    // nominal format; lock() reports the actual plane order.
+    FrameFormat format() const { return m_format; }
+
+    // AHardwareBuffer* on device, the stand-in's storage on the host
+    void* nativeHandle() const { return m_native; }
+
+    // Map for CPU reads, filling `frame` with a non-owning view. Fails if
+    // the planes can't be described by a FrameData. Pair every successful
+    // lock with unlock().
+    bool lock(FrameData& frame);
+    void unlock();
+
+private:
+    friend class HardwareImageReader;
+
+    HardwareBuffer(int width, int height, FrameFormat format, size_t blockSize);
+    ~HardwareBuffer() = default;
+
+    HardwareBuffer(const HardwareBuffer&) = delete;
+    HardwareBuffer& operator=(const HardwareBuffer&) = delete;
+
+    std::atomic<int32_t> m_refs;
+    int m_width;
+    int m_height;
+    FrameFormat m_format;
+    size_t m_blockSize;  // FramePool block holding this header
+    void* m_native;      // AHardwareBuffer*, or stand-in pixels on the host
+    void* m_image;       // AImage* when acquired from a reader
+    HardwareImageReader* m_reader;
+};
+
+// AImageReader that a video decoder renders into. It stays alive until
+// its owner and every image acquired from it have been released.
+class HardwareImageReader {
+public:
+    // Reader for YUV frames holding at most `maxImages` acquired images.
+    // nullptr when hardware buffers are unavailable (always on the host).
+    static HardwareImageReader* create(int width, int height, int maxImages);
+
+    void addRef();
+    void release();
+
+    // ANativeWindow* to pass to AMediaCodec_configure
+    void* window() const { return m_window; }
+
+    // Oldest rendered image not taken yet, nullptr if none is ready
+    HardwareBuffer* acquire(int64_t* timestampUs);
+
+    // Drop rendered images nobody has taken (e.g. after a codec flush).
+    // Returns how many were dropped.
+    int drain();
+
+private:
+    HardwareImageReader(void* reader, void* window, int width, int height);
+    ~HardwareImageReader() = default;
+
+    HardwareImageReader(const HardwareImageReader&) = delete;
+    HardwareImageReader& operator=(const HardwareImageReader&) = delete;
+
+    std::atomic<int32_t> m_refs;
+    void* m_reader;  // AImageReader*
+    void* m_window;  // ANativeWindow*, owned by the reader
+    int m_width;
+    int m_height;
+};
@@ -0,0 +1,108 @@
+/*
+ * DroidFakeCam - Image Frame Map Implementation
+ *
+ * An entry is claimed by moving its state from FREE to FILLING, so two
+ * acquire hooks never pick the same one. The key is written while the
+ * entry is FILLING and published together with the frame by the release
+ * store to READY.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "image_frame_map.hpp"
+
+ImageFrameMap::Entry* ImageFrameMap::find(const void* image, int32_t state) {
+    for (Entry& entry : m_entries) {
+        if (entry.state.load(std::memory_order_acquire) == state &&
+            entry.image.load(std::memory_order_relaxed) == image) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+FrameData* ImageFrameMap::insert(const void* image) {
+    if (!image) {
+        return nullptr;
+    }
+
+    // The pointer may come back for a new image if we missed a delete
+    remove(image);
+
+    for (Entry& entry : m_entries) {
+        int32_t expected = STATE_FREE;
+        if (entry.state.compare_exchange_strong(expected, STATE_FILLING,
+                                                std::memory_order_acq_rel)) {
+            entry.image.store(image, std::memory_order_relaxed);
+            entry.planes.store(0, std::memory_order_relaxed);
+            return &entry.frame;
+        }
+    }
+    return nullptr;
+}
+
+void ImageFrameMap::publish(const void* image) {
+    Entry* entry = find(image, STATE_FILLING);
+    if (entry) {
+        entry->state.store(STATE_READY, std::memory_order_release);
+    }
+}
+
+void ImageFrameMap::abandon(const void* image) {
+    Entry* entry = find(image, STATE_FILLING);
+    if (entry) {
+        entry->image.store(nullptr, std::memory_order_relaxed);
+        entry->state.store(STATE_FREE, std::memory_order_release);
+    }
+}
+
+const FrameData* ImageFrameMap::claimPlane(const void* image, int plane) {
+    if (plane < 0 || plane >= 32) {
+        return nullptr;
+    }
+
+    Entry* entry = find(image, STATE_READY);
+    if (!entry) {
+        return nullptr;
+    }
+
+    uint32_t bit = 1u << plane;
+    if (entry->planes.fetch_or(bit, std::memory_order_relaxed) & bit) {
+        return nullptr;
+    }
+    return &entry->frame;
+}
+
+bool ImageFrameMap::remove(const void* image) {
+    Entry* entry = find(image, STATE_READY);
+    if (!entry) {
+        entry = find(image, STATE_FILLING);
+    }
+    if (!entry) {
+        return false;
+    }
+
+    // The frame's buffer stays with the entry for the next image
+    entry->image.store(nullptr, std::memory_order_relaxed);
+    entry->state.store(STATE_FREE, std::memory_order_release);
+    return true;
+}
+
+void ImageFrameMap::clear() {
+    for (Entry& entry : m_entries) {
+        entry.frame.release();
+        entry.image.store(nullptr, std::memory_order_relaxed);
+        entry.planes.store(0, std::memory_order_relaxed);
+        entry.state.store(STATE_FREE, std::memory_order_release);
+    }
+}
+
+int ImageFrameMap::size() const {
+    int count = 0;
+    for (const Entry& entry : m_entries) {
+        if (entry.state.load(std::memory_order_relaxed) != STATE_FREE) {
+            count++;
+        }
+    }
+    return count;
+}
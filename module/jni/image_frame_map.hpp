@@ -0,0 +1,71 @@
+/*
+ * DroidFakeCam - Image Frame Map Header
+ *
+ * Fixed-capacity map from an acquired AImage to the replacement frame
+ * prepared for it. Each image gets its own entry, already scaled and
+ * converted to that image's size and format, so several ImageReaders
+ * (preview, analysis, capture) can be served at once. Lookups and plane
+ * claims are lock-free; entries keep their buffers for the next image.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_utils.hpp"
+#include <atomic>
+#include <cstdint>
+
+class ImageFrameMap {
+public:
+    // Images in flight across all readers. Camera apps keep a handful
+    // acquired per reader (maxImages is usually 2-4).
+    static constexpr int kCapacity = 16;
+
+    ImageFrameMap() = default;
+
+    // Producer: take a free entry for `image` and return its frame to be
+    // filled, then publish() or abandon() it. nullptr when the map is full.
+    FrameData* insert(const void* image);
+
+    // Make the frame filled after insert() visible to claimPlane()
+    void publish(const void* image);
+
+    // Give the entry back without publishing (preparation failed)
+    void abandon(const void* image);
+
+    // The frame prepared for `image` if plane `plane` hasn't been handed
+    // out for it yet, nullptr otherwise. Each plane is claimed at most once.
+    const FrameData* claimPlane(const void* image, int plane);
+
+    // The image was deleted; its entry becomes free. Returns false if
+    // `image` had no entry.
+    bool remove(const void* image);
+
+    // Free every entry and its buffer
+    void clear();
+
+    // Entries currently holding an image
+    int size() const;
+
+private:
+    enum State : int32_t {
+        STATE_FREE = 0,
+        STATE_FILLING,
+        STATE_READY,
+    };
+
+    struct Entry {
+        std::atomic<int32_t> state{STATE_FREE};
+        std::atomic<const void*> image{nullptr};
+        std::atomic<uint32_t> planes{0};  // Claimed planes, a bit per index
+        FrameData frame;
+    };
+
+    Entry* find(const void* image, int32_t state);
+
+    ImageFrameMap(const ImageFrameMap&) = delete;
+    ImageFrameMap& operator=(const ImageFrameMap&) = delete;
+
+    Entry m_entries[kCapacity];
+};
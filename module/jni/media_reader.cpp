@@ -10,13 +10,21 @@
  */
 
 #include "media_reader.hpp"
+#include "config.hpp"
+#include "frame_simd.hpp"
+#include "nal_parser.hpp"
+#include "pipeline_stats.hpp"
 #include <android/log.h>
 #include <media/NdkMediaExtractor.h>
 #include <media/NdkMediaCodec.h>
 #include <media/NdkMediaFormat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 
@@ -50,6 +58,115 @@ struct BMPInfoHeader {
 };
 #pragma pack(pop)
 
+namespace {
+
+// MediaCodecInfo.CodecCapabilities color formats
+constexpr int32_t COLOR_FormatYUV420Planar = 19;
+constexpr int32_t COLOR_FormatYUV420PackedPlanar = 20;
+constexpr int32_t COLOR_FormatYUV420SemiPlanar = 21;
+constexpr int32_t COLOR_FormatYUV420PackedSemiPlanar = 39;
+constexpr int32_t COLOR_FormatYUV420Flexible = 0x7F420888;
+
+// Vendor color formats hardware decoders report for ByteBuffer output
+// when none was requested
+constexpr int32_t QCOM_FormatYUV420PackedSemiPlanar32m = 0x7FA30C04;  // NV12, aligned
+constexpr int32_t TI_FormatYUV420PackedSemiPlanar = 0x7F000100;
+constexpr int32_t SEC_FormatNV21Linear = 0x7F000011;
+
+// Output format keys not exposed as constants at our API level
+constexpr const char* KEY_SLICE_HEIGHT = "slice-height";
+constexpr const char* KEY_CROP_LEFT = "crop-left";
+constexpr const char* KEY_CROP_TOP = "crop-top";
+constexpr const char* KEY_CROP_RIGHT = "crop-right";
+constexpr const char* KEY_CROP_BOTTOM = "crop-bottom";
+constexpr const char* KEY_CSD_0 = "csd-0";
+
+// FrameFormat for a decoder color format, -1 if we can't read it
+int frameFormatFromColorFormat(int32_t colorFormat) {
+    switch (colorFormat) {
+        case COLOR_FormatYUV420Planar:
+        case COLOR_FormatYUV420PackedPlanar:
+            return FORMAT_YUV420;
+        case COLOR_FormatYUV420SemiPlanar:
+        case COLOR_FormatYUV420PackedSemiPlanar:
+        case QCOM_FormatYUV420PackedSemiPlanar32m:
+        case TI_FormatYUV420PackedSemiPlanar:
+            return FORMAT_NV12;
+        case SEC_FormatNV21Linear:
+            return FORMAT_NV21;
+        default:
+            // Tiled and compressed vendor layouts, and Flexible, whose
+            // ByteBuffer layout only the codec's Image planes describe
+            return -1;
+    }
+}
+
+int64_t steadyNowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A loaded photo or one of its conversions. Keyed by file version and
+// target, so reopening an unchanged file (or capturing again at the same
+// size) reuses the buffer. width/height 0 is the photo as loaded.
+struct PhotoCacheEntry {
+    std::string path;
+    int64_t mtimeNs;
+    int64_t fileSize;
+    FrameFormat format;
+    int width;
+    int height;
+    int rotation;
+    bool mirror;
+
+    int frameWidth;  // Size of the frame in `buffer`
+    int frameHeight;
+    FrameBuffer* buffer;
+
+    bool sameKey(const PhotoCacheEntry& other) const {
+        return path == other.path && mtimeNs == other.mtimeNs &&
+               fileSize == other.fileSize && format == other.format &&
+               width == other.width && height == other.height &&
+               rotation == other.rotation && mirror == other.mirror;
+    }
+};
+
+// Loaded photos and conversions kept across readers (most recent first)
+constexpr size_t kPhotoCacheEntries = 6;
+std::mutex g_photoCacheMutex;
+std::vector<PhotoCacheEntry> g_photoCache;
+
+// Cached buffer for `key` with a reference for the caller, or nullptr.
+// Fills key.frameWidth/frameHeight.
+FrameBuffer* findCachedPhoto(PhotoCacheEntry& key) {
+    std::lock_guard<std::mutex> lock(g_photoCacheMutex);
+    for (size_t i = 0; i < g_photoCache.size(); i++) {
+        if (g_photoCache[i].sameKey(key)) {
+            PhotoCacheEntry entry = g_photoCache[i];
+            g_photoCache.erase(g_photoCache.begin() + i);
+            g_photoCache.insert(g_photoCache.begin(), entry);
+            key.frameWidth = entry.frameWidth;
+            key.frameHeight = entry.frameHeight;
+            entry.buffer->addRef();
+            return entry.buffer;
+        }
+    }
+    return nullptr;
+}
+
+// Remember `entry`; the cache takes its own reference to the buffer
+void storeCachedPhoto(const PhotoCacheEntry& entry) {
+    std::lock_guard<std::mutex> lock(g_photoCacheMutex);
+    entry.buffer->addRef();
+    g_photoCache.insert(g_photoCache.begin(), entry);
+    if (g_photoCache.size() > kPhotoCacheEntries) {
+        g_photoCache.back().buffer->release();
+        g_photoCache.pop_back();
+    }
+}
+
+} // namespace
+
 MediaReader::MediaReader()
     : m_ready(false)
     , m_isVideo(false)
@@ -59,10 +176,47 @@ MediaReader::MediaReader()
     , m_frameRate(30.0f)
     , m_duration(0)
     , m_currentPosition(0)
-    , m_frameFormat(3)  // RGB
+    , m_frameFormat(FORMAT_RGB)
+    , m_decodeAheadDepth(Config::DECODE_AHEAD_FRAMES)
+    , m_decoding(false)
+    , m_seekRequest(-1)
+    , m_seekTarget(-1)
+    , m_seekStartUs(-1)
+    , m_seekLatencyUs(-1)
+    , m_discardUntilUs(-1)
     , m_mediaExtractor(nullptr)
     , m_mediaCodec(nullptr)
     , m_trackIndex(-1)
+    , m_outputMode(OUTPUT_CPU)
+    , m_clockOrigin(CLOCK_UNSET)
+    , m_lastTimestamp(-1)
+    , m_positionOffset(0)
+    , m_loopPeriodUs(0)
+    , m_firstSampleUs(0)
+    , m_clock(&m_clockOrigin)
+    , m_clockLeader(nullptr)
+    , m_clockFollowers(0)
+    , m_clockShift(0)
+    , m_lastPopUs(0)
+    , m_consumerIntervalUs(0)
+    , m_nalSyntax(NalParser::SYNTAX_UNKNOWN)
+    , m_highestTemporalId(-1)
+    , m_lastKeptSampleUs(-1)
+    , m_maxSampleUs(0)
+    , m_loopLengthUs(0)
+    , m_loopCount(0)
+    , m_imageReader(nullptr)
+    , m_outputLayout{FORMAT_YUV420, 0, 0, 0, 0}
+    , m_outputReadable(true)
+    , m_lastDecodedUs(-1)
+    , m_frameCacheEnabled(false)
+    , m_cacheKey{std::string(), 0, 0}
+    , m_cacheFile(nullptr)
+    , m_cacheWriter(nullptr)
+    , m_cacheIndex(0)
+    , m_imageBuffer(nullptr)
+    , m_imageMtimeNs(0)
+    , m_imageFileSize(0)
 {
 }
 
@@ -73,7 +227,7 @@ MediaReader::~MediaReader() {
 bool MediaReader::open(const std::string& path) {
     std::lock_guard<std::mutex> lock(m_mutex);
     
-    close();
+    closeLocked();
     m_path = path;
     
     // Determine file type by extension
@@ -98,8 +252,47 @@ bool MediaReader::open(const std::string& path) {
     return false;
 }
 
+bool MediaReader::probeVideoSize(const std::string& path, int* width, int* height) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    
+    AMediaExtractor* extractor = AMediaExtractor_new();
+    bool found = false;
+    if (extractor && AMediaExtractor_setDataSourceFd(extractor, fd, 0, st.st_size) == AMEDIA_OK) {
+        int numTracks = AMediaExtractor_getTrackCount(extractor);
+        for (int i = 0; i < numTracks && !found; i++) {
+            AMediaFormat* format = AMediaExtractor_getTrackFormat(extractor, i);
+            const char* mime = nullptr;
+            if (AMediaFormat_getString(format, AMEDIAFORMAT_KEY_MIME, &mime) &&
+                strncmp(mime, "video/", 6) == 0) {
+                found = AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_WIDTH, width) &&
+                        AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_HEIGHT, height);
+            }
+            AMediaFormat_delete(format);
+        }
+    }
+    if (extractor) {
+        AMediaExtractor_delete(extractor);
+    }
+    ::close(fd);
+    return found;
+}
+
 void MediaReader::close() {
     std::lock_guard<std::mutex> lock(m_mutex);
+    closeLocked();
+}
+
+void MediaReader::closeLocked() {
+    // The decoder thread owns the codec; stop it before tearing down
+    m_ready = false;
+    stopDecodeThread();
     
     if (m_mediaCodec) {
         AMediaCodec_stop((AMediaCodec*)m_mediaCodec);
@@ -112,19 +305,72 @@ void MediaReader::close() {
         m_mediaExtractor = nullptr;
     }
     
-    m_frameBuffer.clear();
-    m_imageData.clear();
-    m_ready = false;
+    // Outstanding frames keep the reader alive until they are released
+    if (m_imageReader) {
+        m_imageReader->release();
+        m_imageReader = nullptr;
+    }
+    
+    // An unfinished recording is discarded; frames still out keep the
+    // cache file mapped
+    delete m_cacheWriter;
+    m_cacheWriter = nullptr;
+    if (m_cacheFile) {
+        m_cacheFile->release();
+        m_cacheFile = nullptr;
+    }
+    m_cacheFrame.release();
+    
+    m_ring.reset();
+    if (m_imageBuffer) {
+        m_imageBuffer->release();
+        m_imageBuffer = nullptr;
+    }
     m_width = 0;
     m_height = 0;
     m_duration = 0;
     m_currentPosition = 0;
     m_trackIndex = -1;
+    m_sampleTimes.clear();
+    m_syncTimes.clear();
+    m_loopPeriodUs = 0;
+    m_firstSampleUs = 0;
+    if (m_clockLeader) {
+        m_clockLeader->m_clockFollowers--;
+        m_clockLeader = nullptr;
+    }
+    m_clock = &m_clockOrigin;
 }
 
 bool MediaReader::openVideo(const std::string& path) {
     LOGI("Opening video: %s", path.c_str());
     
+    // A loop recorded earlier plays straight from the cache file
+    openFrameCache(path);
+    if (m_cacheFile) {
+        int frames = m_cacheFile->frameCount();
+        int64_t first = m_cacheFile->timestamp(0);
+        int64_t last = m_cacheFile->timestamp(frames - 1);
+        m_width = m_cacheFile->width();
+        m_height = m_cacheFile->height();
+        m_duration = last;
+        if (frames > 1 && last > first) {
+            m_frameRate = static_cast<float>((frames - 1) * 1000000.0 / (last - first));
+        }
+        m_firstSampleUs = first;
+        m_loopPeriodUs = last - first +
+            (m_frameRate > 0 ? static_cast<int64_t>(1000000 / m_frameRate) : 33333);
+        m_isVideo = true;
+        m_cacheIndex = 0;
+        
+        m_ring.reset(new FrameRing(m_decodeAheadDepth));
+        startDecodeThread();
+        m_ready = true;
+        
+        LOGI("Video opened from frame cache: %dx%d, %d frames", m_width, m_height, frames);
+        return true;
+    }
+    
     // Create media extractor
     AMediaExtractor* extractor = AMediaExtractor_new();
     if (!extractor) {
@@ -190,6 +436,9 @@ bool MediaReader::openVideo(const std::string& path) {
                 
                 LOGI("Video: %dx%d @ %.1f fps, duration: %lld us",
                      m_width, m_height, m_frameRate, (long long)m_duration);
+                
+                // Until the decoder reports its real layout
+                m_outputLayout = {FORMAT_YUV420, m_width, m_height, 0, 0};
                 break;
             } else if (strncmp(mime, "audio/", 6) == 0) {
                 m_hasAudio = true;
@@ -207,11 +456,28 @@ bool MediaReader::openVideo(const std::string& path) {
     
     // Select video track
     AMediaExtractor_selectTrack(extractor, m_trackIndex);
+    buildSampleIndex(extractor);
     
     // Create decoder
     const char* mime = nullptr;
     AMediaFormat_getString(format, AMEDIAFORMAT_KEY_MIME, &mime);
     
+    m_highestTemporalId = -1;
+    if (strcmp(mime, "video/avc") == 0) {
+        m_nalSyntax = NalParser::SYNTAX_AVC;
+    } else if (strcmp(mime, "video/hevc") == 0) {
+        m_nalSyntax = NalParser::SYNTAX_HEVC;
+        // The SPS in the codec config says which sub-layer is the top one
+        void* config = nullptr;
+        size_t configSize = 0;
+        if (AMediaFormat_getBuffer(format, KEY_CSD_0, &config, &configSize)) {
+            m_highestTemporalId = NalParser::hevcHighestTemporalId(
+                static_cast<const uint8_t*>(config), configSize);
+        }
+    } else {
+        m_nalSyntax = NalParser::SYNTAX_UNKNOWN;
+    }
+    
     AMediaCodec* codec = AMediaCodec_createDecoderByType(mime);
     if (!codec) {
         LOGE("Failed to create decoder for %s", mime);
@@ -220,8 +486,21 @@ bool MediaReader::openVideo(const std::string& path) {
         return false;
     }
     
+    // Hardware output: render into an image reader with room for every
+    // ring slot plus a couple of frames held by consumers
+    ANativeWindow* window = nullptr;
+    if (m_outputMode == OUTPUT_HARDWARE_BUFFER) {
+        m_imageReader = HardwareImageReader::create(m_width, m_height,
+                                                    m_decodeAheadDepth + 4);
+        if (m_imageReader) {
+            window = (ANativeWindow*)m_imageReader->window();
+        } else {
+            LOGE("Hardware buffer output unavailable, decoding to CPU memory");
+        }
+    }
+    
     // Configure decoder
-    status = AMediaCodec_configure(codec, format, nullptr, nullptr, 0);
+    status = AMediaCodec_configure(codec, format, window, nullptr, 0);
     AMediaFormat_delete(format);
     
     if (status != AMEDIA_OK) {
@@ -243,16 +522,166 @@ bool MediaReader::openVideo(const std::string& path) {
     m_mediaExtractor = extractor;
     m_mediaCodec = codec;
     m_isVideo = true;
-    m_ready = true;
     
-    // Decode first frame
-    decodeVideoFrame();
+    // Decoding happens ahead of the consumer on a dedicated thread
+    m_ring.reset(new FrameRing(m_decodeAheadDepth));
+    startDecodeThread();
+    m_ready = true;
     
-    LOGI("Video opened successfully");
+    LOGI("Video opened successfully (decode-ahead depth %d, %s output)",
+         m_ring->getDepth(), m_imageReader ? "hardware buffer" : "CPU");
     return true;
 }
 
-bool MediaReader::decodeVideoFrame() {
+void MediaReader::buildSampleIndex(void* mediaExtractor) {
+    AMediaExtractor* extractor = (AMediaExtractor*)mediaExtractor;
+    m_sampleTimes.clear();
+    m_syncTimes.clear();
+    
+    // One pass over the track; MediaExtractor reads each sample as it
+    // advances, which for our short loops is a few tens of milliseconds
+    int64_t time;
+    while ((time = AMediaExtractor_getSampleTime(extractor)) >= 0) {
+        m_sampleTimes.push_back(time);
+        if (AMediaExtractor_getSampleFlags(extractor) & AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC) {
+            m_syncTimes.push_back(time);
+        }
+        if (!AMediaExtractor_advance(extractor)) {
+            break;
+        }
+    }
+    AMediaExtractor_seekTo(extractor, 0, AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC);
+    
+    // Decode order -> presentation order
+    std::sort(m_sampleTimes.begin(), m_sampleTimes.end());
+    std::sort(m_syncTimes.begin(), m_syncTimes.end());
+    if (!m_sampleTimes.empty()) {
+        m_firstSampleUs = m_sampleTimes.front();
+        m_loopPeriodUs = m_sampleTimes.back() - m_sampleTimes.front() +
+            (m_frameRate > 0 ? static_cast<int64_t>(1000000 / m_frameRate) : 33333);
+    }
+    LOGD("Indexed %zu samples, %zu sync samples", m_sampleTimes.size(), m_syncTimes.size());
+}
+
+void MediaReader::startDecodeThread() {
+    m_seekRequest = -1;
+    m_seekTarget = -1;
+    m_seekStartUs = -1;
+    m_discardUntilUs = -1;
+    m_outputReadable = true;
+    m_lastDecodedUs = -1;
+    m_clockOrigin = CLOCK_UNSET;
+    m_lastTimestamp = -1;
+    m_positionOffset = 0;
+    m_lastPopUs = 0;
+    m_consumerIntervalUs = 0;
+    m_lastKeptSampleUs = -1;
+    m_maxSampleUs = 0;
+    // One pass ends a frame after the last sample of the index; without
+    // an index the first end of stream fixes it
+    m_loopLengthUs = m_sampleTimes.empty() ? 0 : m_firstSampleUs + m_loopPeriodUs;
+    m_loopCount = 0;
+    m_decoding = true;
+    m_decodeThread = std::thread(&MediaReader::decodeLoop, this);
+}
+
+void MediaReader::stopDecodeThread() {
+    if (!m_decodeThread.joinable()) {
+        return;
+    }
+    
+    m_decoding = false;
+    if (m_ring) {
+        m_ring->wake();
+    }
+    m_decodeThread.join();
+}
+
+void MediaReader::decodeLoop() {
+    pthread_setname_np(pthread_self(), "dfc-decode");
+    
+    AMediaExtractor* extractor = (AMediaExtractor*)m_mediaExtractor;
+    AMediaCodec* codec = (AMediaCodec*)m_mediaCodec;
+    
+    // Wait between retries when the consumer hasn't freed a slot yet
+    const int kSpaceWaitMs = 20;
+    
+    // A seek is pending until its first frame is committed
+    bool seeking = false;
+    
+    while (m_decoding) {
+        int64_t seekTo = m_seekRequest.exchange(-1);
+        if (seekTo >= 0) {
+            // seek() stores the target before the request
+            int64_t target = m_seekTarget.load();
+            seeking = true;
+            if (m_cacheFile) {
+                m_cacheIndex = m_cacheFile->findFrame(target >= 0 ? target : seekTo);
+            } else {
+                // seekTo is a sync sample; frames between it and an
+                // exact target are decoded but never copied or rendered
+                AMediaExtractor_seekTo(extractor, seekTo, AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC);
+                AMediaCodec_flush(codec);
+                m_discardUntilUs = target;
+                
+                // The loop being recorded would have a gap
+                if (m_cacheWriter) {
+                    delete m_cacheWriter;
+                    m_cacheWriter = nullptr;
+                    LOGD("Frame cache: seek during the first loop, not recording");
+                }
+            }
+            // Positions start over at the landing frame's timestamp
+            m_lastTimestamp = -1;
+            m_positionOffset = 0;
+            int flushed = m_ring->flush();
+            if (m_imageReader) {
+                flushed += m_imageReader->drain();
+            }
+            PipelineStats::recordDrop(PipelineStats::DROP_FLUSHED, flushed);
+            LOGD("Decoder seeked to %lld us", (long long)seekTo);
+        }
+        
+        FrameRing::Slot* slot = m_ring->beginWrite();
+        if (!slot) {
+            m_ring->waitForSpace(kSpaceWaitMs);
+            continue;
+        }
+        
+        PipelineStats::ScopedTimer timer(PipelineStats::STAGE_DECODE);
+        if (m_cacheFile ? serveCachedFrame(slot) : decodeVideoFrame(slot)) {
+            stampPosition(slot);
+            m_ring->commitWrite(slot);
+            
+            m_discardUntilUs = -1;
+            if (seeking && m_seekRequest.load() < 0) {
+                seeking = false;
+                int64_t latencyUs = steadyNowUs() - m_seekStartUs.load();
+                m_seekLatencyUs = latencyUs;
+                PipelineStats::record(PipelineStats::STAGE_SEEK,
+                                      static_cast<uint64_t>(latencyUs) * 1000);
+                LOGD("Seek to %lld us ready after %lld us",
+                     (long long)slot->timestamp, (long long)latencyUs);
+            }
+        } else {
+            // Closing or seeking isn't a decode failure
+            timer.discard();
+            if (m_decoding && m_seekRequest.load() < 0 && m_outputReadable) {
+                PipelineStats::recordDrop(PipelineStats::DROP_DECODE);
+            }
+            m_ring->abortWrite(slot);
+            
+            if (!m_outputReadable && !switchToHardwareOutput()) {
+                LOGE("No readable decoder output, video stopped");
+                break;
+            }
+        }
+    }
+    
+    LOGD("Decoder thread exiting");
+}
+
+bool MediaReader::decodeVideoFrame(FrameRing::Slot* slot) {
     if (!m_mediaExtractor || !m_mediaCodec) {
         return false;
     }
@@ -265,7 +694,15 @@ bool MediaReader::decodeVideoFrame() {
     
     bool gotFrame = false;
     
-    while (!gotFrame) {
+    // Bail out on close or a pending seek so neither waits for a frame
+    while (!gotFrame && m_outputReadable && m_decoding && m_seekRequest.load() < 0) {
+        // Hardware output: rendered frames show up in the reader
+        // asynchronously, possibly from an earlier call
+        if (m_imageReader && takeRenderedFrame(slot)) {
+            gotFrame = true;
+            break;
+        }
+        
         // Try to get an input buffer
         ssize_t inputIndex = AMediaCodec_dequeueInputBuffer(codec, kTimeoutUs);
         if (inputIndex >= 0) {
@@ -274,22 +711,33 @@ bool MediaReader::decodeVideoFrame() {
                 codec, inputIndex, &bufferSize);
             
             if (inputBuffer) {
-                // Read sample from extractor
-                ssize_t sampleSize = AMediaExtractor_readSampleData(
-                    extractor, inputBuffer, bufferSize);
+                ssize_t sampleSize = readSample(inputBuffer, bufferSize);
+                if (sampleSize < 0) {
+                    // End of stream: go on with the first sample right away.
+                    // Its timestamp continues after the last one, so the
+                    // codec sees one stream and nothing drains at the loop.
+                    if (m_loopLengthUs == 0) {
+                        int64_t frameUs = m_frameRate > 0 ?
+                            static_cast<int64_t>(1000000 / m_frameRate) : 33333;
+                        m_loopLengthUs = m_maxSampleUs + frameUs;
+                    }
+                    m_loopCount++;
+                    AMediaExtractor_seekTo(extractor, 0, AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC);
+                    sampleSize = readSample(inputBuffer, bufferSize);
+                }
                 
                 if (sampleSize >= 0) {
                     int64_t presentationTime = AMediaExtractor_getSampleTime(extractor);
+                    m_maxSampleUs = std::max(m_maxSampleUs, presentationTime);
                     uint32_t flags = 0;
                     
                     AMediaCodec_queueInputBuffer(
-                        codec, inputIndex, 0, sampleSize, 
-                        presentationTime, flags);
+                        codec, inputIndex, 0, sampleSize,
+                        presentationTime + m_loopCount * m_loopLengthUs, flags);
                     
                     AMediaExtractor_advance(extractor);
                 } else {
-                    // End of stream - loop back to beginning
-                    AMediaExtractor_seekTo(extractor, 0, AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC);
+                    // Nothing to play; hand the buffer back empty
                     AMediaCodec_queueInputBuffer(
                         codec, inputIndex, 0, 0, 0, 0);
                 }
@@ -301,21 +749,41 @@ bool MediaReader::decodeVideoFrame() {
         ssize_t outputIndex = AMediaCodec_dequeueOutputBuffer(
             codec, &bufferInfo, kTimeoutUs);
         
-        if (outputIndex >= 0) {
+        if (outputIndex >= 0 && m_discardUntilUs >= 0 &&
+            sourceTimestamp(bufferInfo.presentationTimeUs) < m_discardUntilUs) {
+            // Decoding forward to an exact seek target
+            AMediaCodec_releaseOutputBuffer(codec, outputIndex, false);
+        } else if (outputIndex >= 0 && m_imageReader) {
+            // Render into the image reader; no CPU copy
+            AMediaCodec_releaseOutputBuffer(codec, outputIndex, bufferInfo.size > 0);
+        } else if (outputIndex >= 0) {
             if (bufferInfo.size > 0) {
                 size_t outSize = 0;
                 uint8_t* outputBuffer = AMediaCodec_getOutputBuffer(
                     codec, outputIndex, &outSize);
                 
                 if (outputBuffer && bufferInfo.size > 0) {
-                    // Store the decoded frame
-                    m_frameBuffer.resize(bufferInfo.size);
-                    memcpy(m_frameBuffer.data(), outputBuffer, bufferInfo.size);
-                    m_currentPosition = bufferInfo.presentationTimeUs;
+                    // Store the decoded frame in the ring slot
+                    uint8_t* dst = slot->prepare(bufferInfo.size);
+                    memcpy(dst, outputBuffer + bufferInfo.offset, bufferInfo.size);
+                    // Padding stays in place; downstream honours the layout
+                    slot->width = m_width;
+                    slot->height = m_height;
+                    slot->format = m_outputLayout.format;
+                    slot->stride = m_outputLayout.stride;
+                    slot->sliceHeight = m_outputLayout.sliceHeight;
+                    slot->cropLeft = m_outputLayout.cropLeft;
+                    slot->cropTop = m_outputLayout.cropTop;
+                    slot->timestamp = sourceTimestamp(bufferInfo.presentationTimeUs);
+                    m_lastDecodedUs = slot->timestamp;
                     gotFrame = true;
                     
                     LOGD("Decoded frame at %lld us, size=%d",
-                         (long long)m_currentPosition, bufferInfo.size);
+                         (long long)slot->timestamp, bufferInfo.size);
+                    
+                    if (m_cacheWriter) {
+                        recordCachedFrame(slot);
+                    }
                 }
             }
             
@@ -323,15 +791,7 @@ bool MediaReader::decodeVideoFrame() {
         } else if (outputIndex == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
             AMediaFormat* format = AMediaCodec_getOutputFormat(codec);
             if (format) {
-                AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_WIDTH, &m_width);
-                AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_HEIGHT, &m_height);
-                
-                int32_t colorFormat = 0;
-                AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_COLOR_FORMAT, &colorFormat);
-                
-                LOGD("Output format changed: %dx%d, color=%d",
-                     m_width, m_height, colorFormat);
-                
+                updateOutputLayout(format);
                 AMediaFormat_delete(format);
             }
         }
@@ -340,22 +800,311 @@ bool MediaReader::decodeVideoFrame() {
     return gotFrame;
 }
 
+ssize_t MediaReader::readSample(uint8_t* buffer, size_t capacity) {
+    // Samples that would never be shown are passed over
+    AMediaExtractor* extractor = (AMediaExtractor*)m_mediaExtractor;
+    ssize_t sampleSize;
+    while ((sampleSize = AMediaExtractor_readSampleData(extractor, buffer, capacity)) >= 0 &&
+           skipSample(buffer, static_cast<size_t>(sampleSize))) {
+        PipelineStats::recordDrop(PipelineStats::DROP_UNDECODED);
+        AMediaExtractor_advance(extractor);
+    }
+    return sampleSize;
+}
+
+int64_t MediaReader::sourceTimestamp(int64_t codecTimestampUs) const {
+    return m_loopLengthUs > 0 ? codecTimestampUs % m_loopLengthUs : codecTimestampUs;
+}
+
+bool MediaReader::skipSample(const uint8_t* data, size_t size) {
+    AMediaExtractor* extractor = (AMediaExtractor*)m_mediaExtractor;
+    int64_t timestampUs = AMediaExtractor_getSampleTime(extractor);
+    int64_t frameUs = m_frameRate > 0 ? static_cast<int64_t>(1000000 / m_frameRate) : 33333;
+    int64_t consumerUs = m_consumerIntervalUs.load(std::memory_order_relaxed);
+    
+    // Nothing before an exact seek target is shown
+    if (m_discardUntilUs >= 0 && timestampUs < m_discardUntilUs &&
+        !(AMediaExtractor_getSampleFlags(extractor) & AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC) &&
+        NalParser::isDisposableSample(m_nalSyntax, m_highestTemporalId, data, size)) {
+        return true;
+    }
+    
+    // Only worth it while the camera takes frames well below the video's
+    // rate; then keep about one sample per camera frame. Sync samples and
+    // anything later frames predict from are always decoded, and so is
+    // every sample of a loop the frame cache is recording.
+    bool keep = m_cacheWriter || consumerUs < frameUs * 3 / 2 ||
+                m_lastKeptSampleUs < 0 || timestampUs < m_lastKeptSampleUs ||
+                timestampUs - m_lastKeptSampleUs >= consumerUs - frameUs / 2 ||
+                (AMediaExtractor_getSampleFlags(extractor) & AMEDIAEXTRACTOR_SAMPLE_FLAG_SYNC) ||
+                !NalParser::isDisposableSample(m_nalSyntax, m_highestTemporalId, data, size);
+    if (keep) {
+        m_lastKeptSampleUs = timestampUs;
+    }
+    return !keep;
+}
+
+void MediaReader::stampPosition(FrameRing::Slot* slot) {
+    // Timestamps going backwards mean the video looped (seeks start
+    // positions over); continue from one frame after the previous one
+    if (m_lastTimestamp >= 0 && slot->timestamp <= m_lastTimestamp) {
+        int64_t frameUs = m_frameRate > 0 ? static_cast<int64_t>(1000000 / m_frameRate) : 33333;
+        // A whole loop when its length is known, so positions stay on
+        // the loop grid even if the last frames were skipped
+        m_positionOffset += m_loopPeriodUs > 0 ? m_loopPeriodUs :
+                            m_lastTimestamp + frameUs - slot->timestamp;
+    }
+    slot->position = slot->timestamp + m_positionOffset;
+    m_lastTimestamp = slot->timestamp;
+}
+
+void MediaReader::updateOutputLayout(void* outputFormat) {
+    AMediaFormat* format = (AMediaFormat*)outputFormat;
+    
+    // Buffer dimensions; the visible area is the crop rect inside them
+    int32_t width = m_width;
+    int32_t height = m_height;
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_WIDTH, &width);
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_HEIGHT, &height);
+    
+    int32_t stride = width;
+    int32_t sliceHeight = height;
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_STRIDE, &stride);
+    AMediaFormat_getInt32(format, KEY_SLICE_HEIGHT, &sliceHeight);
+    
+    int32_t cropLeft = 0;
+    int32_t cropTop = 0;
+    int32_t cropRight = width - 1;
+    int32_t cropBottom = height - 1;
+    AMediaFormat_getInt32(format, KEY_CROP_LEFT, &cropLeft);
+    AMediaFormat_getInt32(format, KEY_CROP_TOP, &cropTop);
+    AMediaFormat_getInt32(format, KEY_CROP_RIGHT, &cropRight);
+    AMediaFormat_getInt32(format, KEY_CROP_BOTTOM, &cropBottom);
+    
+    int32_t colorFormat = 0;
+    AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_COLOR_FORMAT, &colorFormat);
+    int frameFormat = frameFormatFromColorFormat(colorFormat);
+    if (frameFormat < 0 && !m_imageReader) {
+        // Guessing would scramble the chroma; decodeLoop() moves the
+        // codec to an image reader, which describes the planes
+        LOGE("Decoder color format 0x%x can't be read from memory", colorFormat);
+        m_outputReadable = false;
+        return;
+    }
+    
+    // 4:2:0 chroma needs an even visible origin and size
+    cropLeft &= ~1;
+    cropTop &= ~1;
+    m_width = (cropRight - cropLeft + 1) & ~1;
+    m_height = (cropBottom - cropTop + 1) & ~1;
+    
+    m_outputLayout.format = static_cast<FrameFormat>(frameFormat);
+    m_outputLayout.stride = std::max(stride, width);
+    // Some decoders report 0 or leave out the slice height
+    m_outputLayout.sliceHeight = std::max(sliceHeight, height);
+    m_outputLayout.cropLeft = cropLeft;
+    m_outputLayout.cropTop = cropTop;
+    
+    LOGD("Output format changed: %dx%d visible in %dx%d (stride %d, slice height %d, "
+         "crop %d,%d), color=0x%x -> format %d",
+         m_width, m_height, width, height, m_outputLayout.stride,
+         m_outputLayout.sliceHeight, cropLeft, cropTop, colorFormat, frameFormat);
+}
+
+bool MediaReader::switchToHardwareOutput() {
+    AMediaExtractor* extractor = (AMediaExtractor*)m_mediaExtractor;
+    AMediaCodec* codec = (AMediaCodec*)m_mediaCodec;
+    
+    m_imageReader = HardwareImageReader::create(m_width, m_height, m_decodeAheadDepth + 4);
+    if (!m_imageReader) {
+        return false;
+    }
+    
+    // The codec only takes a surface at configure time
+    AMediaFormat* format = AMediaExtractor_getTrackFormat(extractor, m_trackIndex);
+    AMediaCodec_stop(codec);
+    media_status_t status = AMediaCodec_configure(
+        codec, format, (ANativeWindow*)m_imageReader->window(), nullptr, 0);
+    AMediaFormat_delete(format);
+    if (status == AMEDIA_OK) {
+        status = AMediaCodec_start(codec);
+    }
+    if (status != AMEDIA_OK) {
+        LOGE("Failed to restart decoder with hardware output: %d", status);
+        m_imageReader->release();
+        m_imageReader = nullptr;
+        return false;
+    }
+    
+    // Frame cache files hold CPU frames
+    if (m_cacheWriter) {
+        delete m_cacheWriter;
+        m_cacheWriter = nullptr;
+    }
+    
+    // Carry on after the last frame handed out
+    int64_t resumeUs = m_lastDecodedUs + 1;
+    AMediaExtractor_seekTo(extractor, resumeUs, AMEDIAEXTRACTOR_SEEK_PREVIOUS_SYNC);
+    m_discardUntilUs = resumeUs;
+    m_outputReadable = true;
+    
+    LOGI("Decoder moved to hardware buffer output");
+    return true;
+}
+
+bool MediaReader::takeRenderedFrame(FrameRing::Slot* slot) {
+    int64_t timestampUs = 0;
+    HardwareBuffer* hardware = m_imageReader->acquire(&timestampUs);
+    if (!hardware) {
+        return false;
+    }
+    
+    timestampUs = sourceTimestamp(timestampUs);
+    m_lastDecodedUs = timestampUs;
+    slot->attach(hardware);
+    slot->width = hardware->width();
+    slot->height = hardware->height();
+    slot->format = hardware->format();
+    slot->stride = hardware->width();
+    slot->sliceHeight = 0;  // lock() reports the real layout
+    slot->cropLeft = 0;
+    slot->cropTop = 0;
+    slot->timestamp = timestampUs;
+    
+    LOGD("Decoded frame at %lld us into hardware buffer %p",
+         (long long)timestampUs, hardware->nativeHandle());
+    hardware->release();  // The slot holds its own reference
+    return true;
+}
+
+void MediaReader::openFrameCache(const std::string& path) {
+    struct stat st;
+    if (!m_frameCacheEnabled || m_outputMode != OUTPUT_CPU || stat(path.c_str(), &st) != 0) {
+        return;
+    }
+    
+    m_cacheKey = {path, static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                        st.st_mtim.tv_nsec,
+                  static_cast<int64_t>(st.st_size)};
+    m_cacheFile = FrameCacheFile::open(Config::CACHE_DIR, m_cacheKey);
+    if (!m_cacheFile) {
+        m_cacheWriter = FrameCacheWriter::create(Config::CACHE_DIR, m_cacheKey,
+                                                 Config::FRAME_CACHE_BUDGET_BYTES);
+    }
+}
+
+void MediaReader::recordCachedFrame(const FrameRing::Slot* slot) {
+    // Timestamps start over once the decoder has looped: the recording
+    // is complete, and from here on frames come from the file
+    if (m_cacheWriter->frameCount() > 0 &&
+        slot->timestamp <= m_cacheWriter->firstTimestamp()) {
+        if (m_cacheWriter->finish()) {
+            m_cacheFile = FrameCacheFile::open(Config::CACHE_DIR, m_cacheKey);
+        }
+        delete m_cacheWriter;
+        m_cacheWriter = nullptr;
+        
+        if (m_cacheFile) {
+            // `slot` already holds the file's first frame
+            m_cacheIndex = m_cacheFile->findFrame(slot->timestamp + 1);
+            AMediaCodec_stop((AMediaCodec*)m_mediaCodec);
+            LOGI("Playing from frame cache, decoder stopped");
+        }
+        return;
+    }
+    
+    // Packed I420 at the visible size: playback then needs no crop or
+    // chroma shuffling, only what the output plan does anyway
+    FrameData decoded;
+    decoded.data = slot->buffer->data();
+    decoded.ownsData = false;
+    decoded.size = slot->size;
+    decoded.width = slot->width;
+    decoded.height = slot->height;
+    decoded.format = slot->format;
+    decoded.stride = slot->stride;
+    decoded.sliceHeight = slot->sliceHeight;
+    decoded.cropLeft = slot->cropLeft;
+    decoded.cropTop = slot->cropTop;
+    
+    if (!FrameTransform::apply(decoded, m_cacheFrame, FORMAT_YUV420, slot->width,
+                               slot->height, {0, false}) ||
+        !m_cacheWriter->append(m_cacheFrame, slot->timestamp)) {
+        delete m_cacheWriter;
+        m_cacheWriter = nullptr;
+    }
+}
+
+bool MediaReader::serveCachedFrame(FrameRing::Slot* slot) {
+    FrameBuffer* frame = m_cacheFile->wrapFrame(m_cacheIndex);
+    slot->attach(frame);
+    frame->release();  // The slot holds its own reference
+    slot->size = m_cacheFile->frameSize();
+    slot->width = m_cacheFile->width();
+    slot->height = m_cacheFile->height();
+    slot->format = m_cacheFile->format();
+    slot->stride = m_cacheFile->width();
+    slot->sliceHeight = 0;
+    slot->cropLeft = 0;
+    slot->cropTop = 0;
+    slot->timestamp = m_cacheFile->timestamp(m_cacheIndex);
+    
+    m_cacheIndex = (m_cacheIndex + 1) % m_cacheFile->frameCount();
+    return true;
+}
+
 bool MediaReader::loadBmpImage(const std::string& path) {
     LOGI("Loading BMP image: %s", path.c_str());
     
-    FILE* file = fopen(path.c_str(), "rb");
-    if (!file) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
         LOGE("Failed to open BMP file: %s", path.c_str());
+        if (fd >= 0) {
+            ::close(fd);
+        }
         return false;
     }
     
-    // Read file header
+    // Unchanged since it was last loaded: share the converted frame
+    PhotoCacheEntry key = {path, static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                                 st.st_mtim.tv_nsec,
+                           static_cast<int64_t>(st.st_size), FORMAT_NV21, 0, 0, 0, false,
+                           0, 0, nullptr};
+    if (FrameBuffer* cached = findCachedPhoto(key)) {
+        ::close(fd);
+        m_imageBuffer = cached;
+        m_imageMtimeNs = key.mtimeNs;
+        m_imageFileSize = key.fileSize;
+        m_width = key.frameWidth;
+        m_height = key.frameHeight;
+        m_frameFormat = FORMAT_NV21;
+        m_isVideo = false;
+        m_ready = true;
+        LOGI("BMP unchanged, using cached frame: %dx%d", m_width, m_height);
+        return true;
+    }
+    
+    size_t fileSize = static_cast<size_t>(st.st_size);
+    void* mapping = fileSize > 0 ?
+        mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        LOGE("Failed to map BMP file: %s", path.c_str());
+        return false;
+    }
+    const uint8_t* file = static_cast<const uint8_t*>(mapping);
+    
+    // Read file and info headers
     BMPFileHeader fileHeader;
-    if (fread(&fileHeader, sizeof(fileHeader), 1, file) != 1) {
-        LOGE("Failed to read BMP file header");
-        fclose(file);
+    BMPInfoHeader infoHeader;
+    if (fileSize < sizeof(fileHeader) + sizeof(infoHeader)) {
+        LOGE("Failed to read BMP headers");
+        munmap(mapping, fileSize);
         return false;
     }
+    memcpy(&fileHeader, file, sizeof(fileHeader));
+    memcpy(&infoHeader, file + sizeof(fileHeader), sizeof(infoHeader));
     
     // BMP file signature constant
     static constexpr uint16_t BMP_SIGNATURE = 0x4D42;  // 'BM'
@@ -363,72 +1112,79 @@ bool MediaReader::loadBmpImage(const std::string& path) {
     // Validate signature
     if (fileHeader.signature != BMP_SIGNATURE) {
         LOGE("Invalid BMP signature: 0x%04X", fileHeader.signature);
-        fclose(file);
-        return false;
-    }
-    
-    // Read info header
-    BMPInfoHeader infoHeader;
-    if (fread(&infoHeader, sizeof(infoHeader), 1, file) != 1) {
-        LOGE("Failed to read BMP info header");
-        fclose(file);
+        munmap(mapping, fileSize);
         return false;
     }
     
-    m_width = infoHeader.width;
-    m_height = std::abs(infoHeader.height);
+    int fileWidth = infoHeader.width;
+    int fileHeight = std::abs(infoHeader.height);
     bool bottomUp = infoHeader.height > 0;
     
     LOGD("BMP: %dx%d, %d bpp, compression=%d",
-         m_width, m_height, infoHeader.bitsPerPixel, infoHeader.compression);
+         fileWidth, fileHeight, infoHeader.bitsPerPixel, infoHeader.compression);
     
     if (infoHeader.bitsPerPixel != 24 && infoHeader.bitsPerPixel != 32) {
         LOGE("Unsupported BMP bit depth: %d", infoHeader.bitsPerPixel);
-        fclose(file);
+        munmap(mapping, fileSize);
         return false;
     }
     
     if (infoHeader.compression != 0) {
         LOGE("Compressed BMP not supported");
-        fclose(file);
+        munmap(mapping, fileSize);
         return false;
     }
     
-    // Seek to pixel data
-    fseek(file, fileHeader.dataOffset, SEEK_SET);
-    
     // Calculate row stride (BMP rows are padded to 4-byte boundaries)
     int bytesPerPixel = infoHeader.bitsPerPixel / 8;
-    int rowSize = ((m_width * bytesPerPixel + 3) / 4) * 4;
+    size_t rowSize = ((static_cast<size_t>(fileWidth) * bytesPerPixel + 3) / 4) * 4;
+    if (fileWidth < 2 || fileHeight < 2 || fileHeader.dataOffset > fileSize ||
+        rowSize * fileHeight > fileSize - fileHeader.dataOffset) {
+        LOGE("BMP pixel data truncated or empty");
+        munmap(mapping, fileSize);
+        return false;
+    }
+    const uint8_t* pixels = file + fileHeader.dataOffset;
     
-    // Allocate and read pixel data
-    std::vector<uint8_t> rowBuffer(rowSize);
-    m_imageData.resize(m_width * m_height * 3);  // Store as RGB
-    m_frameFormat = 3;  // RGB
+    // Converted straight to NV21, which needs even sizes (an odd last row
+    // or column is dropped)
+    m_width = fileWidth & ~1;
+    m_height = fileHeight & ~1;
+    m_imageBuffer = FrameBuffer::acquire(static_cast<size_t>(m_width) * m_height * 3 / 2);
+    m_frameFormat = FORMAT_NV21;
     
-    for (int y = 0; y < m_height; y++) {
-        if (fread(rowBuffer.data(), 1, rowSize, file) != (size_t)rowSize) {
-            LOGE("Failed to read BMP row %d", y);
-            fclose(file);
-            return false;
-        }
-        
-        // Determine output row (flip if bottom-up)
-        int outY = bottomUp ? (m_height - 1 - y) : y;
-        uint8_t* outRow = m_imageData.data() + outY * m_width * 3;
-        
-        for (int x = 0; x < m_width; x++) {
-            int inIdx = x * bytesPerPixel;
-            int outIdx = x * 3;
-            
-            // BMP is BGR, convert to RGB
-            outRow[outIdx] = rowBuffer[inIdx + 2];     // R
-            outRow[outIdx + 1] = rowBuffer[inIdx + 1]; // G
-            outRow[outIdx + 2] = rowBuffer[inIdx];     // B
+    uint8_t* yPlane = m_imageBuffer->data();
+    uint8_t* vuPlane = yPlane + static_cast<size_t>(m_width) * m_height;
+    const FrameSimd::Kernels& kernels = FrameSimd::best();
+    
+    // Two rows at a time: BGR(A) -> RGB, then one row pair of NV21
+    std::vector<uint8_t> rgbRows(static_cast<size_t>(m_width) * 3 * 2);
+    for (int y = 0; y < m_height; y += 2) {
+        for (int r = 0; r < 2; r++) {
+            // Determine source row (flip if bottom-up)
+            int row = bottomUp ? (fileHeight - 1 - (y + r)) : (y + r);
+            const uint8_t* in = pixels + rowSize * row;
+            uint8_t* out = rgbRows.data() + static_cast<size_t>(r) * m_width * 3;
+            for (int x = 0; x < m_width; x++) {
+                out[x * 3] = in[x * bytesPerPixel + 2];      // R
+                out[x * 3 + 1] = in[x * bytesPerPixel + 1];  // G
+                out[x * 3 + 2] = in[x * bytesPerPixel];      // B
+            }
         }
+        kernels.rgbToNv21(rgbRows.data(), m_width * 3,
+                          yPlane + static_cast<size_t>(y) * m_width, m_width,
+                          vuPlane + static_cast<size_t>(y / 2) * m_width, m_width,
+                          m_width, 2);
     }
     
-    fclose(file);
+    munmap(mapping, fileSize);
+    
+    m_imageMtimeNs = key.mtimeNs;
+    m_imageFileSize = key.fileSize;
+    key.frameWidth = m_width;
+    key.frameHeight = m_height;
+    key.buffer = m_imageBuffer;
+    storeCachedPhoto(key);
     
     m_isVideo = false;
     m_ready = true;
@@ -447,29 +1203,83 @@ bool MediaReader::loadImage(const std::string& path) {
     return false;
 }
 
-bool MediaReader::getNextFrame(FrameData& frame) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
+bool MediaReader::getNextFrame(FrameRef& frame) {
+    // No lock here: the ring is safe against the decoder thread, and the
+    // caller keeps the reader alive (see CameraHook's g_mutex).
     if (!m_ready) {
         return false;
     }
     
     if (m_isVideo) {
-        // Decode next video frame
-        if (!decodeVideoFrame()) {
-            return false;
+        int64_t nowUs = steadyNowUs();
+        
+        // Start the clock at the first frame (the first of any reader
+        // sharing it)
+        std::atomic<int64_t>& clock = *m_clock;
+        int64_t origin = clock.load(std::memory_order_acquire);
+        int64_t next = 0;
+        bool queued = m_ring->nextPosition(&next);
+        if (queued && origin == CLOCK_UNSET) {
+            int64_t unset = CLOCK_UNSET;
+            origin = nowUs - next;
+            if (!clock.compare_exchange_strong(unset, origin, std::memory_order_acq_rel)) {
+                origin = unset;
+            }
+            m_clockShift = 0;
+        }
+        
+        // How far the queue is off schedule, whole loops aside
+        if (queued && origin != CLOCK_UNSET) {
+            int64_t offUs = next - (nowUs - origin - m_clockShift);
+            if (m_loopPeriodUs > 0) {
+                int64_t half = m_loopPeriodUs / 2;
+                int64_t loops = (offUs + (offUs >= 0 ? half : -half)) / m_loopPeriodUs;
+                m_clockShift -= loops * m_loopPeriodUs;
+                offUs -= loops * m_loopPeriodUs;
+            }
+            
+            // Far off (seeks, decoder stalls, the camera pausing): restart
+            // the clock, or if other readers go by it, seek to where it is
+            if (std::abs(offUs) > SCHEDULE_RESYNC_US) {
+                if (!m_clockLeader && m_clockFollowers.load() == 0) {
+                    origin = nowUs - next - m_clockShift;
+                    clock.store(origin, std::memory_order_release);
+                } else if (m_seekRequest.load() < 0 && m_loopPeriodUs > 0) {
+                    int64_t dueUs = nowUs - origin - m_clockShift +
+                                    std::max<int64_t>(m_seekLatencyUs.load(), 0);
+                    int64_t intoLoop = (dueUs - m_firstSampleUs) % m_loopPeriodUs;
+                    if (intoLoop < 0) {
+                        intoLoop += m_loopPeriodUs;
+                    }
+                    startSeek(m_firstSampleUs + intoLoop, SEEK_EXACT, false);
+                }
+            }
+        }
+        
+        // How often frames are asked for (all streams together), for the
+        // decoder's skip policy
+        int64_t lastPopUs = m_lastPopUs.exchange(nowUs, std::memory_order_relaxed);
+        int64_t intervalUs = nowUs - lastPopUs;
+        if (lastPopUs > 0 && intervalUs < SCHEDULE_RESYNC_US) {
+            int64_t average = m_consumerIntervalUs.load(std::memory_order_relaxed);
+            m_consumerIntervalUs.store(average > 0 ? (average * 7 + intervalUs) / 8 : intervalUs,
+                                       std::memory_order_relaxed);
         }
         
-        // Return the decoded frame
-        frame.width = m_width;
-        frame.height = m_height;
-        frame.format = 1;  // YUV420 from decoder
-        frame.stride = m_width;
-        frame.size = m_frameBuffer.size();
-        frame.data = new uint8_t[frame.size];
-        memcpy(frame.data, m_frameBuffer.data(), frame.size);
-        frame.timestamp = m_currentPosition;
+        int advanced = 0;
+        int64_t dueUs = origin == CLOCK_UNSET ? CLOCK_UNSET : nowUs - origin - m_clockShift;
+        if (!m_ring->popDue(frame, dueUs, &advanced)) {
+            return false;  // Decoder hasn't produced the first frame yet
+        }
+        if (advanced > 1) {
+            PipelineStats::recordDrop(PipelineStats::DROP_SKIPPED, advanced - 1);
+        } else if (advanced == 0 && !queued) {
+            // Repeats are expected while the next frame isn't due; without
+            // one queued the decoder fell behind
+            PipelineStats::recordDrop(PipelineStats::DROP_REPEATED);
+        }
         
+        m_currentPosition = frame.timestamp;
         return true;
     }
     
@@ -477,36 +1287,132 @@ bool MediaReader::getNextFrame(FrameData& frame) {
     return getPhotoFrame(frame);
 }
 
-bool MediaReader::getPhotoFrame(FrameData& frame) {
+bool MediaReader::getPhotoFrame(FrameRef& frame) {
     std::lock_guard<std::mutex> lock(m_mutex);
     
-    if (!m_ready || m_imageData.empty()) {
+    if (!m_ready || !m_imageBuffer) {
         return false;
     }
     
+    frame.reset(m_imageBuffer);
     frame.width = m_width;
     frame.height = m_height;
     frame.format = m_frameFormat;
-    frame.stride = m_width * 3;
-    frame.size = m_imageData.size();
-    frame.data = new uint8_t[frame.size];
-    memcpy(frame.data, m_imageData.data(), frame.size);
+    frame.stride = m_width;
+    frame.size = static_cast<size_t>(m_width) * m_height * 3 / 2;
     frame.timestamp = 0;
     
     return true;
 }
 
-bool MediaReader::seek(int64_t timestampUs) {
+bool MediaReader::getPhotoFrame(FrameRef& frame, FrameFormat format, int width, int height,
+                                FrameTransform::Orientation orientation) {
+    FrameUtils::PlaneLayout layout;
+    if (!FrameUtils::getPlaneLayout(format, width, height, 0, layout)) {
+        return false;
+    }
+    
+    FrameRef photo;
+    if (!getPhotoFrame(photo)) {
+        return false;
+    }
+    
+    PhotoCacheEntry key = {m_path, m_imageMtimeNs, m_imageFileSize, format, width, height,
+                           orientation.rotation, orientation.mirror, 0, 0, nullptr};
+    FrameBuffer* buffer = findCachedPhoto(key);
+    if (!buffer) {
+        FrameData source;
+        FrameData converted;
+        photo.view(source);
+        if (!FrameTransform::apply(source, converted, format, width, height, orientation)) {
+            return false;
+        }
+        
+        buffer = FrameBuffer::acquire(converted.size);
+        memcpy(buffer->data(), converted.data, converted.size);
+        key.frameWidth = width;
+        key.frameHeight = height;
+        key.buffer = buffer;
+        storeCachedPhoto(key);
+        LOGD("Photo converted for %dx%d (format %d)", width, height, format);
+    }
+    
+    frame.reset(buffer);
+    buffer->release();  // The FrameRef holds its own reference
+    frame.width = width;
+    frame.height = height;
+    frame.format = format;
+    frame.stride = layout.planes[0].stride;
+    frame.sliceHeight = 0;
+    frame.cropLeft = 0;
+    frame.cropTop = 0;
+    frame.size = FrameUtils::getLayoutSize(layout);
+    frame.timestamp = 0;
+    return true;
+}
+
+bool MediaReader::seek(int64_t timestampUs, SeekMode mode) {
+    return startSeek(timestampUs, mode, true);
+}
+
+bool MediaReader::startSeek(int64_t timestampUs, SeekMode mode, bool restartClock) {
     std::lock_guard<std::mutex> lock(m_mutex);
     
-    if (!m_ready || !m_isVideo || !m_mediaExtractor) {
+    if (!m_ready || !m_isVideo || (!m_mediaExtractor && !m_cacheFile)) {
         return false;
     }
+    if (timestampUs < 0) {
+        timestampUs = 0;
+    }
     
-    AMediaExtractor* extractor = (AMediaExtractor*)m_mediaExtractor;
-    AMediaExtractor_seekTo(extractor, timestampUs, AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC);
-    m_currentPosition = timestampUs;
+    // Where the seek lands: a sync sample, or the frame showing at the
+    // target and the sync sample decoding starts from. Without an index
+    // (e.g. playing from the frame cache) the target is taken as is.
+    int64_t landing = timestampUs;
+    int64_t from = timestampUs;
+    if (mode == SEEK_SYNC && !m_syncTimes.empty()) {
+        auto after = std::lower_bound(m_syncTimes.begin(), m_syncTimes.end(), timestampUs);
+        if (after == m_syncTimes.end() ||
+            (after != m_syncTimes.begin() && timestampUs - *(after - 1) < *after - timestampUs)) {
+            --after;
+        }
+        landing = *after;
+        from = landing;
+    } else if (mode == SEEK_EXACT && !m_sampleTimes.empty()) {
+        auto frame = std::upper_bound(m_sampleTimes.begin(), m_sampleTimes.end(), timestampUs);
+        landing = frame == m_sampleTimes.begin() ? *frame : *(frame - 1);
+        auto sync = std::upper_bound(m_syncTimes.begin(), m_syncTimes.end(), landing);
+        from = sync == m_syncTimes.begin() ? landing : *(sync - 1);
+    }
+    
+    // Performed by the decoder thread, which owns the extractor and codec.
+    // The clock restarts at the first frame that shows up, unless the
+    // seek is to keep up with it.
+    m_seekStartUs = steadyNowUs();
+    m_seekTarget = mode == SEEK_EXACT ? landing : -1;
+    m_seekRequest = from;
+    if (restartClock) {
+        m_clock->store(CLOCK_UNSET);
+    }
+    m_ring->wake();
+    m_currentPosition = landing;
+    
+    return true;
+}
+
+bool MediaReader::shareClock(MediaReader* leader) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    // Whole loops on one reader's clock must be whole loops on the other's
+    if (!m_ready || !m_isVideo || m_loopPeriodUs <= 0 ||
+        std::abs(m_loopPeriodUs - leader->m_loopPeriodUs) > 1000) {
+        return false;
+    }
     
+    leader->m_clockFollowers++;
+    m_clockLeader = leader;
+    m_clock = &leader->m_clockOrigin;
+    m_clockShift = 0;
     return true;
 }
 
@@ -10,23 +10,65 @@
 #pragma once
 
 #include "frame_utils.hpp"
+#include "frame_cache.hpp"
+#include "frame_ring.hpp"
+#include "frame_transform.hpp"
+#include "hardware_buffer.hpp"
+#include "nal_parser.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <mutex>
+#include <sys/types.h>
 
 class MediaReader {
 public:
+    // Where decoded video frames end up
+    enum OutputMode {
+        OUTPUT_CPU = 0,        // Copied into pooled FrameBuffers
+        OUTPUT_HARDWARE_BUFFER // Rendered into an AImageReader, handed out
+                               // as FrameRef::hardwareBuffer() handles
+    };
+    
     MediaReader();
     ~MediaReader();
     
     // Open media file (video or image)
     bool open(const std::string& path);
     
+    // Read a video's frame size from its container without decoding
+    static bool probeVideoSize(const std::string& path, int* width, int* height);
+    
     // Close and release resources
     void close();
     
     // Check if ready
-    bool isReady() const { return m_ready; }
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+    
+    // Number of frames the decoder thread keeps ready ahead of the consumer.
+    // Takes effect on the next open().
+    void setDecodeAheadDepth(int frames) { m_decodeAheadDepth = frames; }
+    int getDecodeAheadDepth() const { return m_decodeAheadDepth; }
+    
+    // Requested video output mode. Takes effect on the next open();
+    // hardware output falls back to OUTPUT_CPU where it isn't available.
+    void setOutputMode(OutputMode mode) { m_outputMode = mode; }
+    
+    // Record the first loop of a video to the frame cache and play later
+    // loops (and later opens of the same file) from there, without
+    // decoding. CPU output only. Takes effect on the next open().
+    void setFrameCacheEnabled(bool enabled) { m_frameCacheEnabled = enabled; }
+    
+    // Output mode the open video actually uses
+    OutputMode getOutputMode() const {
+        return m_imageReader ? OUTPUT_HARDWARE_BUFFER : OUTPUT_CPU;
+    }
+    
+    // Decoded frames waiting in the ring (0 for images)
+    int getQueuedFrames() const { return m_ring ? m_ring->pending() : 0; }
     
     // Get media info
     int getWidth() const { return m_width; }
@@ -36,23 +78,51 @@ public:
     bool hasAudio() const { return m_hasAudio; }
     bool isVideo() const { return m_isVideo; }
     
-    // Get next frame (loops for video)
-    bool getNextFrame(FrameData& frame);
+    // Get next frame (loops for video). For video this never waits on the
+    // decoder: it takes the frame due at this moment by the video's own
+    // timestamps, repeating or skipping frames when the camera runs faster
+    // or slower than the video. The returned view shares the reader's
+    // buffer; nothing is copied.
+    bool getNextFrame(FrameRef& frame);
+    
+    // Get photo frame (shares the loaded image, nothing is copied)
+    bool getPhotoFrame(FrameRef& frame);
+    
+    // Photo scaled, oriented and converted for a width x height target of
+    // `format`. Conversions are cached per file version and target, so
+    // repeat captures share one buffer.
+    bool getPhotoFrame(FrameRef& frame, FrameFormat format, int width, int height,
+                       FrameTransform::Orientation orientation);
     
-    // Get photo frame
-    bool getPhotoFrame(FrameData& frame);
+    // How seek() lands
+    enum SeekMode {
+        SEEK_SYNC = 0,  // On the sync sample nearest the target: fastest
+        SEEK_EXACT      // On the frame showing at the target, decoding
+                        // forward from the sync sample before it
+    };
     
-    // Seek to position (for video)
-    bool seek(int64_t timestampUs);
+    // Seek to position (for video). getCurrentPosition() reports where
+    // the seek lands.
+    bool seek(int64_t timestampUs, SeekMode mode = SEEK_SYNC);
     
     // Reset to beginning
     void reset();
     
+    // Time from the last seek() until its first frame was ready, -1 if
+    // there hasn't been one
+    int64_t getLastSeekLatencyUs() const { return m_seekLatencyUs.load(); }
+    
     // Get current position
-    int64_t getCurrentPosition() const { return m_currentPosition; }
+    int64_t getCurrentPosition() const { return m_currentPosition.load(); }
+    
+    // Play in step with `leader`, another rendition of the same video
+    // that outlives this reader: frames come due on the leader's clock,
+    // and either reader seeks rather than leave it. False (and no change)
+    // if their loops differ in length. Call before taking frames.
+    bool shareClock(MediaReader* leader);
 
 private:
-    bool m_ready;
+    std::atomic<bool> m_ready;
     bool m_isVideo;
     bool m_hasAudio;
     
@@ -61,26 +131,126 @@ private:
     int m_height;
     float m_frameRate;
     int64_t m_duration;  // microseconds
-    int64_t m_currentPosition;
+    std::atomic<int64_t> m_currentPosition;
     
-    // Decoded frame data
-    std::vector<uint8_t> m_frameBuffer;
-    int m_frameFormat;  // Format of stored frame
+    FrameFormat m_frameFormat;  // Format of stored frame
+    
+    // Decode-ahead ring filled by the decoder thread
+    int m_decodeAheadDepth;
+    std::unique_ptr<FrameRing> m_ring;
+    std::thread m_decodeThread;
+    std::atomic<bool> m_decoding;
+    std::atomic<int64_t> m_seekRequest;  // -1 when no seek is pending
+    std::atomic<int64_t> m_seekTarget;   // First frame to keep, -1 for any
+    std::atomic<int64_t> m_seekStartUs;  // Steady clock time of seek()
+    std::atomic<int64_t> m_seekLatencyUs;
+    
+    // Presentation times of the video's samples and of its sync samples,
+    // ascending. Built by openVideo(), read-only afterwards.
+    std::vector<int64_t> m_sampleTimes;
+    std::vector<int64_t> m_syncTimes;
+    
+    // Decoder thread: outputs before this are dropped unseen (-1 = none)
+    int64_t m_discardUntilUs;
     
     // Video decoder state (using MediaCodec via NDK)
     void* m_mediaExtractor;  // AMediaExtractor*
     void* m_mediaCodec;      // AMediaCodec*
     int m_trackIndex;
     
-    // For image files
-    std::vector<uint8_t> m_imageData;
+    // Hardware output: the codec renders into this reader's window
+    OutputMode m_outputMode;
+    
+    // Playback clock. Frame positions are timestamps continued across
+    // loop points (decoder thread); a frame is due once the time since
+    // m_clockOrigin reaches its position.
+    static constexpr int64_t CLOCK_UNSET = INT64_MIN;
+    // Restart the clock when the queue is this far off schedule (seeks,
+    // decoder stalls, the camera pausing)
+    static constexpr int64_t SCHEDULE_RESYNC_US = 500000;
+    std::atomic<int64_t> m_clockOrigin;  // steady clock us at position 0
+    int64_t m_lastTimestamp;   // Of the previous decoded frame, -1 at start
+    int64_t m_positionOffset;  // Added to timestamps after loop points
+    
+    // Positions of one loop span m_loopPeriodUs from m_firstSampleUs, so a
+    // position is its frame's timestamp plus whole loops (0 if unknown)
+    int64_t m_loopPeriodUs;
+    int64_t m_firstSampleUs;
+    
+    // Clock sharing between renditions. m_clock is m_clockOrigin, or the
+    // leader's; each reader shifts it by whole loops of its own
+    // (getNextFrame callers only), as their positions count loops apart.
+    std::atomic<int64_t>* m_clock;
+    MediaReader* m_clockLeader;
+    std::atomic<int> m_clockFollowers;
+    int64_t m_clockShift;
+    
+    // Input-side skipping: samples no frame depends on are left out when
+    // the camera asks for frames much less often than the video has them
+    std::atomic<int64_t> m_lastPopUs;          // When getNextFrame last ran
+    std::atomic<int64_t> m_consumerIntervalUs; // Average time between calls
+    NalParser::Syntax m_nalSyntax;             // Of the video track
+    int m_highestTemporalId;                   // H.265 sub-layers, -1 if unknown
+    int64_t m_lastKeptSampleUs;                // Decoder thread only
+    
+    // Looping (decoder thread only): each pass is queued with timestamps
+    // m_loopLengthUs after the previous one, so the codec never sees
+    // them go backwards, and sourceTimestamp() takes them modulo the same
+    // length. Fixed from the sample index when decoding starts.
+    int64_t m_maxSampleUs;   // Latest sample timestamp read
+    int64_t m_loopLengthUs;  // Duration of one pass, 0 if not known yet
+    int64_t m_loopCount;
+    HardwareImageReader* m_imageReader;
+    
+    // Layout of the codec's output buffers (decoder thread only). Frames
+    // keep the padding; m_width/m_height are the visible crop size.
+    struct OutputLayout {
+        FrameFormat format;  // Matches the codec's color format
+        int stride;       // Bytes per luma row
+        int sliceHeight;  // Luma rows before the chroma planes
+        int cropLeft;
+        int cropTop;
+    };
+    OutputLayout m_outputLayout;
+    bool m_outputReadable;  // False when CPU output is in a layout we can't read
+    int64_t m_lastDecodedUs;  // Source time of the last frame decoded, -1 if none
+    
+    // Frame cache (decoder thread only once open): the file frames are
+    // served from, or the writer recording the first loop
+    bool m_frameCacheEnabled;
+    FrameCache::Key m_cacheKey;  // Version of the open video
+    FrameCacheFile* m_cacheFile;
+    FrameCacheWriter* m_cacheWriter;
+    int m_cacheIndex;          // Next frame served from m_cacheFile
+    FrameData m_cacheFrame;    // Decoded frame packed for the writer
+    
+    // For image files (stored as NV21, shared with outstanding FrameRefs)
+    FrameBuffer* m_imageBuffer;
+    int64_t m_imageMtimeNs;  // Version of the file m_imageBuffer came from
+    int64_t m_imageFileSize;
     
     std::mutex m_mutex;
     
     // Internal methods
+    void closeLocked();
     bool openVideo(const std::string& path);
     bool openImage(const std::string& path);
-    bool decodeVideoFrame();
+    void startDecodeThread();
+    void stopDecodeThread();
+    void decodeLoop();
+    bool decodeVideoFrame(FrameRing::Slot* slot);
+    bool takeRenderedFrame(FrameRing::Slot* slot);
+    ssize_t readSample(uint8_t* buffer, size_t capacity);
+    int64_t sourceTimestamp(int64_t codecTimestampUs) const;
+    bool skipSample(const uint8_t* data, size_t size);
+    void stampPosition(FrameRing::Slot* slot);
+    void openFrameCache(const std::string& path);
+    void recordCachedFrame(const FrameRing::Slot* slot);
+    bool serveCachedFrame(FrameRing::Slot* slot);
+    void updateOutputLayout(void* format);  // AMediaFormat*
+    bool switchToHardwareOutput();
+    void buildSampleIndex(void* extractor);  // AMediaExtractor*
+    bool startSeek(int64_t timestampUs, SeekMode mode, bool restartClock);
     bool loadBmpImage(const std::string& path);
     bool loadImage(const std::string& path);
 };
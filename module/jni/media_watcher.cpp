@@ -0,0 +1,189 @@
+/*
+ * DroidFakeCam - Media Watcher Implementation
+ *
+ * Every event only (re)arms a per-file deadline; a file is reported when
+ * its deadline passes, so the stream of IN_MODIFY events of a large copy
+ * collapses into one callback after the last write.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "media_watcher.hpp"
+#include <android/log.h>
+#include <chrono>
+#include <map>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+namespace {
+
+constexpr uint32_t kWatchMask = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE |
+                                IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+
+using Clock = std::chrono::steady_clock;
+
+} // namespace
+
+MediaWatcher::MediaWatcher()
+    : m_inotifyFd(-1)
+    , m_wakeFd(-1)
+    , m_callback(nullptr)
+    , m_running(false)
+{
+}
+
+MediaWatcher::~MediaWatcher() {
+    stop();
+}
+
+bool MediaWatcher::start(const std::vector<std::string>& dirs, Callback callback) {
+    stop();
+
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+        LOGE("MediaWatcher: inotify_init1 failed");
+        return false;
+    }
+
+    int watched = 0;
+    for (const std::string& dir : dirs) {
+        if (watch(dir)) {
+            watched++;
+        }
+    }
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (watched == 0 || m_wakeFd < 0) {
+        LOGE("MediaWatcher: Nothing to watch");
+        stop();
+        return false;
+    }
+
+    m_callback = callback;
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&MediaWatcher::run, this);
+    return true;
+}
+
+void MediaWatcher::stop() {
+    m_running.store(false, std::memory_order_release);
+    if (m_thread.joinable()) {
+        uint64_t one = 1;
+        if (write(m_wakeFd, &one, sizeof(one)) < 0) {
+            LOGE("MediaWatcher: Cannot wake watcher thread");
+        }
+        m_thread.join();
+    }
+
+    if (m_inotifyFd >= 0) {
+        ::close(m_inotifyFd);
+        m_inotifyFd = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        m_watches.clear();
+    }
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+}
+
+bool MediaWatcher::watch(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(m_watchMutex);
+    if (m_inotifyFd < 0) {
+        return false;
+    }
+    int wd = inotify_add_watch(m_inotifyFd, dir.c_str(), kWatchMask);
+    if (wd < 0) {
+        return false;
+    }
+    if (m_watches.insert({dir, wd}).second) {
+        LOGD("MediaWatcher: Watching %s", dir.c_str());
+    }
+    return true;
+}
+
+void MediaWatcher::unwatch(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(m_watchMutex);
+    auto it = m_watches.find(dir);
+    if (it == m_watches.end()) {
+        return;
+    }
+    // Two watched paths can't share a descriptor unless they are the
+    // same directory; keep it while another path still needs it
+    int wd = it->second;
+    m_watches.erase(it);
+    for (const auto& entry : m_watches) {
+        if (entry.second == wd) {
+            return;
+        }
+    }
+    if (m_inotifyFd >= 0) {
+        inotify_rm_watch(m_inotifyFd, wd);
+    }
+    LOGD("MediaWatcher: No longer watching %s", dir.c_str());
+}
+
+void MediaWatcher::run() {
+    // Files with events, by the time they settle
+    std::map<std::string, Clock::time_point> pending;
+    alignas(inotify_event) char buffer[4096];
+
+    while (m_running.load(std::memory_order_acquire)) {
+        int timeoutMs = -1;
+        if (!pending.empty()) {
+            Clock::time_point next = pending.begin()->second;
+            for (const auto& entry : pending) {
+                if (entry.second < next) {
+                    next = entry.second;
+                }
+            }
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next - Clock::now()).count();
+            timeoutMs = remaining > 0 ? static_cast<int>(remaining) : 0;
+        }
+
+        pollfd fds[2] = {{m_inotifyFd, POLLIN, 0}, {m_wakeFd, POLLIN, 0}};
+        if (poll(fds, 2, timeoutMs) < 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ssize_t length;
+            while ((length = read(m_inotifyFd, buffer, sizeof(buffer))) > 0) {
+                for (ssize_t offset = 0; offset < length;) {
+                    const inotify_event* event =
+                        reinterpret_cast<const inotify_event*>(buffer + offset);
+                    // Events of a dropped watch (IN_IGNORED) carry no name
+                    if (event->len > 0) {
+                        pending[event->name] = Clock::now() +
+                            std::chrono::milliseconds(SETTLE_MS);
+                    }
+                    offset += sizeof(inotify_event) + event->len;
+                }
+            }
+        }
+
+        Clock::time_point now = Clock::now();
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->second <= now) {
+                std::string name = it->first;
+                it = pending.erase(it);
+                LOGD("MediaWatcher: %s changed", name.c_str());
+                m_callback(name);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
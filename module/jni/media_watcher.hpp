@@ -0,0 +1,61 @@
+/*
+ * DroidFakeCam - Media Watcher Header
+ *
+ * Watches the media directories with inotify and reports files (and
+ * directories) that were written, created, moved in or removed, so a new
+ * video or control file is picked up without polling. Callbacks run on the watcher's own thread once a
+ * file has stopped changing, never half way through a copy.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MediaWatcher {
+public:
+    // Called with the name (no directory) of a file or directory that
+    // changed
+    typedef void (*Callback)(const std::string& name);
+
+    // A file is reported once it has had no events for this long
+    static constexpr int SETTLE_MS = 500;
+
+    MediaWatcher();
+    ~MediaWatcher();
+
+    // Watch `dirs` (not recursively) and start the thread. Directories
+    // that don't exist are skipped; fails if none can be watched.
+    bool start(const std::vector<std::string>& dirs, Callback callback);
+
+    // Stop the thread. Must not be called from the callback.
+    void stop();
+
+    // Add or drop one directory while running, e.g. from the callback.
+    // Adding fails if the directory doesn't exist (yet).
+    bool watch(const std::string& dir);
+    void unwatch(const std::string& dir);
+
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+private:
+    void run();
+
+    MediaWatcher(const MediaWatcher&) = delete;
+    MediaWatcher& operator=(const MediaWatcher&) = delete;
+
+    int m_inotifyFd;
+    int m_wakeFd;  // eventfd that interrupts the thread for stop()
+    Callback m_callback;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+
+    std::mutex m_watchMutex;
+    std::map<std::string, int> m_watches;  // Directory -> watch descriptor
+};
@@ -0,0 +1,125 @@
+/*
+ * DroidFakeCam - NAL Parser Implementation
+ *
+ * For educational and research purposes only.
+ */
+
+#include "nal_parser.hpp"
+
+namespace {
+
+constexpr int kHevcSps = 33;
+
+// Find the NAL unit at or after `*pos`, setting [*begin, *end) to it
+// (header first) and `*pos` past it. False at the end of the data or
+// on a length that runs past it.
+bool nextNal(const uint8_t* data, size_t size, bool startCodes,
+             size_t* pos, size_t* begin, size_t* end) {
+    if (startCodes) {
+        // Skip this NAL's start code, then find the next one
+        size_t p = *pos;
+        while (p < size && data[p] == 0) {
+            p++;
+        }
+        if (p >= size || data[p] != 1) {
+            return false;
+        }
+        *begin = p + 1;
+        size_t e = *begin;
+        while (e + 2 < size && !(data[e] == 0 && data[e + 1] == 0 && data[e + 2] <= 1)) {
+            e++;
+        }
+        *end = e + 2 >= size ? size : e;
+    } else {
+        if (size - *pos < 4) {
+            return false;
+        }
+        const uint8_t* p = data + *pos;
+        size_t length = (static_cast<size_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        *begin = *pos + 4;
+        if (length > size - *begin) {
+            return false;
+        }
+        *end = *begin + length;
+    }
+    *pos = *end;
+    return true;
+}
+
+bool hasStartCodes(const uint8_t* data, size_t size) {
+    return size >= 4 && data[0] == 0 && data[1] == 0 &&
+           (data[2] == 1 || (data[2] == 0 && data[3] == 1));
+}
+
+// True if `nal` (header first) is a slice no other frame predicts from.
+// `vcl` is set to whether it is a slice at all.
+bool isNonReferenceNal(NalParser::Syntax syntax, int highestTemporalId,
+                       const uint8_t* nal, size_t size, bool* vcl) {
+    if (syntax == NalParser::SYNTAX_AVC) {
+        int type = nal[0] & 0x1f;
+        *vcl = type >= 1 && type <= 5;
+        return *vcl && (nal[0] & 0x60) == 0;
+    }
+    if (size < 2) {
+        *vcl = false;
+        return false;
+    }
+    // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N and the reserved _N types,
+    // in the top sub-layer where nothing above can refer to them
+    int type = (nal[0] >> 1) & 0x3f;
+    int temporalId = (nal[1] & 7) - 1;
+    *vcl = type <= 31;
+    return type <= 14 && type % 2 == 0 &&
+           highestTemporalId >= 0 && temporalId == highestTemporalId;
+}
+
+} // namespace
+
+namespace NalParser {
+
+int hevcHighestTemporalId(const uint8_t* data, size_t size) {
+    bool startCodes = hasStartCodes(data, size);
+    size_t pos = 0;
+    size_t begin;
+    size_t end;
+    while (nextNal(data, size, startCodes, &pos, &begin, &end)) {
+        // Two byte NAL header, then sps_video_parameter_set_id (4 bits)
+        // and sps_max_sub_layers_minus1 (3 bits)
+        if (end - begin >= 3 && ((data[begin] >> 1) & 0x3f) == kHevcSps) {
+            return (data[begin + 2] >> 1) & 7;
+        }
+    }
+    return -1;
+}
+
+bool isDisposableSample(Syntax syntax, int highestTemporalId,
+                        const uint8_t* data, size_t size) {
+    if (syntax == SYNTAX_UNKNOWN || size < 4) {
+        return false;
+    }
+
+    bool sawSlice = false;
+    bool startCodes = hasStartCodes(data, size);
+    size_t pos = 0;
+    size_t begin;
+    size_t end;
+    while (pos < size && nextNal(data, size, startCodes, &pos, &begin, &end)) {
+        if (begin == end) {
+            continue;
+        }
+        bool vcl = false;
+        bool nonReference = isNonReferenceNal(syntax, highestTemporalId,
+                                              data + begin, end - begin, &vcl);
+        if (vcl && !nonReference) {
+            return false;
+        }
+        sawSlice = sawSlice || vcl;
+    }
+    // A length prefix running past the sample: don't trust any of it
+    if (!startCodes && pos < size) {
+        return false;
+    }
+    return sawSlice;
+}
+
+} // namespace NalParser
@@ -0,0 +1,38 @@
+/*
+ * DroidFakeCam - NAL Parser Header
+ *
+ * Just enough H.264/H.265 bitstream parsing to tell samples no other
+ * frame predicts from, so the decoder can be spared them when the camera
+ * takes frames at a fraction of the video's rate.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace NalParser {
+
+// Bitstreams whose NAL headers tell reference from non-reference frames
+enum Syntax {
+    SYNTAX_UNKNOWN = 0,
+    SYNTAX_AVC,   // H.264: nal_ref_idc
+    SYNTAX_HEVC   // H.265: sub-layer non-reference picture types
+};
+
+// Highest TemporalId of an H.265 stream (sps_max_sub_layers_minus1 of
+// its first SPS), from codec config or a sample. -1 if there is no SPS.
+int hevcHighestTemporalId(const uint8_t* data, size_t size);
+
+// True if every slice in the sample is non-reference, i.e. the decoder
+// can leave it out without breaking any later frame. H.265 slices only
+// qualify in the highest temporal sub-layer (`highestTemporalId`; none
+// if negative): lower sub-layers' _N pictures are still referenced from
+// the layers above. Handles start code (what MediaExtractor hands out)
+// and 4-byte length prefixed samples.
+bool isDisposableSample(Syntax syntax, int highestTemporalId,
+                        const uint8_t* data, size_t size);
+
+} // namespace NalParser
@@ -0,0 +1,103 @@
+/*
+ * DroidFakeCam - Output Plan Implementation
+ *
+ * For educational and research purposes only.
+ */
+
+#include "output_plan.hpp"
+#include "frame_pool.hpp"
+#include "frame_scaler.hpp"
+#include <android/log.h>
+#include <media/NdkImage.h>
+
+#define LOG_TAG "DroidFakeCam"
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+
+using FrameUtils::PlaneLayout;
+
+namespace {
+
+// Prepared frames usually in flight per surface (one being read, one
+// being acquired)
+constexpr int kWarmBuffers = 2;
+
+} // namespace
+
+bool OutputPlan::init(void* target, void* reader, int width, int height, int32_t windowFormat) {
+    // YUV_420_888 chroma may be planar or interleaved; preparing I420 keeps
+    // every plane a single strided copy whichever the image uses
+    FrameFormat prepared;
+    switch (windowFormat) {
+        case AIMAGE_FORMAT_YUV_420_888:
+            prepared = FORMAT_YUV420;
+            break;
+        case AIMAGE_FORMAT_RGBA_8888:
+            prepared = FORMAT_RGBA;
+            break;
+        case AIMAGE_FORMAT_RGB_888:
+            prepared = FORMAT_RGB;
+            break;
+        default:
+            return false;
+    }
+
+    PlaneLayout layout;
+    if (width <= 0 || height <= 0 ||
+        !FrameUtils::getPlaneLayout(prepared, width, height, 0, layout)) {
+        return false;
+    }
+
+    this->target = target;
+    this->reader = reader;
+    this->width = width;
+    this->height = height;
+    this->windowFormat = windowFormat;
+    format = prepared;
+    orientation = {0, false};
+    srcWidth = 0;
+    srcHeight = 0;
+    return true;
+}
+
+void OutputPlan::prepare(int srcWidth, int srcHeight) {
+    if (srcWidth <= 0 || srcHeight <= 0 ||
+        (srcWidth == this->srcWidth && srcHeight == this->srcHeight)) {
+        return;
+    }
+    this->srcWidth = srcWidth;
+    this->srcHeight = srcHeight;
+
+    // Camera buffers are in sensor orientation, which apps turn a quarter
+    // for display. A source shaped like the display rather than the
+    // surface is turned the other way so it comes out upright.
+    bool srcPortrait = srcHeight > srcWidth;
+    bool dstPortrait = height > width;
+    orientation = {srcPortrait != dstPortrait ? 270 : 0, false};
+
+    // FrameScaler caches plans by size, so building them here is enough
+    // for FrameTransform to find them
+    bool quarter = orientation.rotation == 90 || orientation.rotation == 270;
+    int orientedWidth = quarter ? srcHeight : srcWidth;
+    int orientedHeight = quarter ? srcWidth : srcHeight;
+    FrameScaler::getPlan(orientedWidth, orientedHeight, width, height);
+    if (orientedWidth % 2 == 0 && orientedHeight % 2 == 0) {
+        // Chroma of YUV sources
+        FrameScaler::getPlan(orientedWidth / 2, orientedHeight / 2, width / 2, height / 2);
+    }
+
+    // Leave destination blocks cached in the pool for the first frames
+    PlaneLayout layout;
+    FrameUtils::getPlaneLayout(format, width, height, 0, layout);
+    size_t bytes = FrameUtils::getLayoutSize(layout);
+    uint8_t* blocks[kWarmBuffers];
+    size_t capacities[kWarmBuffers];
+    for (int i = 0; i < kWarmBuffers; i++) {
+        blocks[i] = FramePool::acquire(bytes, &capacities[i]);
+    }
+    for (int i = 0; i < kWarmBuffers; i++) {
+        FramePool::release(blocks[i], capacities[i]);
+    }
+
+    LOGD("Output plan %p: %dx%d (format %d) from %dx%d, rotation %d",
+         target, width, height, format, srcWidth, srcHeight, orientation.rotation);
+}
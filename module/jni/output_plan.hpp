@@ -0,0 +1,49 @@
+/*
+ * DroidFakeCam - Output Plan Header
+ *
+ * How decoded frames are turned into frames for one camera output
+ * surface: the size and format to prepare, the orientation to apply and
+ * the scaler tables and buffers that takes. Plans are made when the app
+ * registers an AImageReader's surface (ACameraOutputTarget_create), so
+ * the first captured frame doesn't pay for the setup.
+ *
+ * For educational and research purposes only.
+ */
+
+#pragma once
+
+#include "frame_transform.hpp"
+#include "frame_utils.hpp"
+#include <cstdint>
+
+struct OutputPlan {
+    void* target;             // ACameraOutputTarget* the plan belongs to
+    void* reader;             // AImageReader* whose surface it is
+    int width;                // Surface size
+    int height;
+    int32_t windowFormat;     // AIMAGE_FORMAT_* of the surface
+    FrameFormat format;       // Format frames are prepared in
+    FrameTransform::Orientation orientation;
+    int srcWidth;             // Source size the plan was prepared for
+    int srcHeight;
+
+    OutputPlan() : target(nullptr), reader(nullptr), width(0), height(0), windowFormat(0),
+                   format(FORMAT_YUV420), orientation{0, false},
+                   srcWidth(0), srcHeight(0) {}
+
+    // Set up for `reader`'s width x height surface of `windowFormat`.
+    // False if frames can't be injected into that format (e.g. JPEG or
+    // PRIVATE).
+    bool init(void* target, void* reader, int width, int height, int32_t windowFormat);
+
+    // Pick the orientation for srcWidth x srcHeight frames and build the
+    // scaler tables and destination buffers for it. Does nothing if the
+    // plan is already prepared for that size.
+    void prepare(int srcWidth, int srcHeight);
+
+    // True for images this plan's surface produces
+    bool matches(int width, int height, int32_t imageFormat) const {
+        return this->width == width && this->height == height &&
+               windowFormat == imageFormat;
+    }
+};
@@ -0,0 +1,157 @@
+/*
+ * DroidFakeCam - Pipeline Stats Implementation
+ *
+ * Each stage owns a fixed log-linear histogram in the style of
+ * HdrHistogram: values below 16 ns get their own bucket, above that every
+ * power of two is split into 16 equal sub-buckets. Recording is a handful
+ * of relaxed atomic increments, so decoder and camera threads never
+ * contend on a lock.
+ *
+ * For educational and research purposes only.
+ */
+
+#include "pipeline_stats.hpp"
+
+namespace PipelineStats {
+
+namespace detail {
+std::atomic<bool> g_enabled{false};
+}
+
+namespace {
+
+constexpr int kSubBucketBits = 4;
+constexpr int kSubBuckets = 1 << kSubBucketBits;
+// Largest exponent tracked; slower samples land in the top bucket
+constexpr int kMaxExponent = 40;  // ~18 minutes
+constexpr int kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+struct Histogram {
+    std::atomic<uint32_t> buckets[kBucketCount];
+    std::atomic<uint64_t> max;
+};
+
+Histogram g_histograms[STAGE_COUNT];
+std::atomic<uint64_t> g_drops[DROP_COUNT];
+
+int bucketIndex(uint64_t ns) {
+    if (ns < kSubBuckets) {
+        return static_cast<int>(ns);
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    if (exponent > kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    int sub = static_cast<int>(ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// Middle of the value range a bucket covers
+uint64_t bucketValue(int index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    int shift = index / kSubBuckets - 1;
+    uint64_t low = static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+} // namespace
+
+void setEnabled(bool enabled) {
+    detail::g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void record(Stage stage, uint64_t ns) {
+    if (stage < 0 || stage >= STAGE_COUNT) {
+        return;
+    }
+    Histogram& h = g_histograms[stage];
+    h.buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = h.max.load(std::memory_order_relaxed);
+    while (ns > max &&
+           !h.max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void recordDrop(Drop drop, uint64_t count) {
+    if (drop < 0 || drop >= DROP_COUNT || !isEnabled()) {
+        return;
+    }
+    g_drops[drop].fetch_add(count, std::memory_order_relaxed);
+}
+
+StageSummary getSummary(Stage stage) {
+    StageSummary summary = {};
+    if (stage < 0 || stage >= STAGE_COUNT) {
+        return summary;
+    }
+
+    // Snapshot the buckets first; samples recorded meanwhile may or may
+    // not be included, which is fine for monitoring
+    const Histogram& h = g_histograms[stage];
+    uint32_t counts[kBucketCount];
+    uint64_t total = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] = h.buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    summary.count = total;
+    summary.maxNs = h.max.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return summary;
+    }
+
+    // Sample rank each percentile falls on (rounded up, at least 1)
+    const uint64_t ranks[3] = {
+        (total * 50 + 99) / 100,
+        (total * 95 + 99) / 100,
+        (total * 99 + 99) / 100,
+    };
+    uint64_t* outputs[3] = {&summary.p50Ns, &summary.p95Ns, &summary.p99Ns};
+
+    uint64_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < kBucketCount && next < 3; i++) {
+        seen += counts[i];
+        while (next < 3 && seen >= ranks[next]) {
+            uint64_t value = bucketValue(i);
+            *outputs[next++] = value < summary.maxNs ? value : summary.maxNs;
+        }
+    }
+    return summary;
+}
+
+uint64_t getDrops(Drop drop) {
+    if (drop < 0 || drop >= DROP_COUNT) {
+        return 0;
+    }
+    return g_drops[drop].load(std::memory_order_relaxed);
+}
+
+void reset() {
+    for (Histogram& h : g_histograms) {
+        for (auto& bucket : h.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        h.max.store(0, std::memory_order_relaxed);
+    }
+    for (auto& drops : g_drops) {
+        drops.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case STAGE_DECODE: return "decode";
+        case STAGE_CONVERT: return "convert";
+        case STAGE_SCALE: return "scale";
+        case STAGE_TRANSFORM: return "transform";
+        case STAGE_INJECT: return "inject";
+        case STAGE_SEEK: return "seek";
+        default: return "?";
+    }
+}
+
+} // namespace PipelineStats
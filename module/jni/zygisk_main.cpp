@@ -51,7 +51,9 @@ public:
             LOGD("preAppSpecialize: %s", app_name.c_str());
         }
         
-        // Check if module is disabled
+        // Check if module is disabled, with the control files as they are
+        // now rather than zygote's snapshot
+        Config::refresh();
         if (Config::isDisabled()) {
             LOGI("Module disabled via disable.jpg");
             api->setOption(zygisk::DLCLOSE_MODULE_LIBRARY);